@@ -0,0 +1,124 @@
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+#include "flock.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <vector>
+#include <boost/program_options.hpp>
+
+namespace po = boost::program_options;
+
+// fixed dt so every run of a combination does exactly the same work
+constexpr float BENCH_DT = 1.f / 60.f;
+
+/// @brief time a number of updates of a new flock
+/// @param params parameters of the flock
+/// @param ticks number of updates to time
+/// @param state set to the bytes of state each update rewrites for a boid
+/// @param upload set to the bytes each update uploads for a boid
+/// @return time taken by the updates (seconds)
+static double time_updates(const Flock::parameters &params, unsigned int ticks, std::size_t &state, std::size_t &upload)
+{
+    Flock flock(params);
+    state = flock.state_bytes();
+    upload = flock.upload_bytes();
+
+    auto start = std::chrono::steady_clock::now();
+    for (unsigned int t = 0; t < ticks; ++t)
+        flock.update(BENCH_DT);
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+int main(int argc, char *argv[])
+{
+    Flock::parameters params;
+    unsigned int ticks, runs;
+
+    po::options_description desc("Times the update of every wrap, field of view and separation combination");
+    try
+    {
+        desc.add_options()("help,h", "help screen")("n", po::value<int>(&params.n)->default_value(2000), "number of boids")("seed", po::value<unsigned int>(&params.seed)->default_value(1), "seed for random number generator used, fixed so every run does the same work")("ticks", po::value<unsigned int>(&ticks)->default_value(200), "updates timed per run")("runs", po::value<unsigned int>(&runs)->default_value(5), "runs per combination")("compact", po::bool_switch(&params.compact)->default_value(false), "use the compact boid representation")("processes", po::value<int>(&params.processes)->default_value(1), "worker processes updating vertical strips of the world");
+
+        po::variables_map vm;
+        po::store(po::parse_command_line(argc, argv, desc), vm);
+        po::notify(vm);
+
+        if (vm.count("help"))
+        {
+            std::cout << desc << '\n';
+            return 0;
+        }
+        if (params.n < 1 || runs < 1)
+            throw po::error("n and runs must be at least 1");
+        if (params.processes < 1 || params.processes > static_cast<int>(MAX_TILES) || (params.compact && params.processes > 1))
+            throw po::error("processes must be in [1, 32] and can not be combined with compact");
+    }
+    catch (std::exception &e)
+    {
+        std::cerr << e.what() << '\n';
+        return 1;
+    }
+
+    // the flock uploads its draw data every update so it needs a context, the window is never shown
+    if (!glfwInit())
+        return -1;
+
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+    glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+    GLFWwindow *window = glfwCreateWindow(params.width, params.height, "Flocking Benchmark", NULL, NULL);
+    if (!window)
+    {
+        glfwTerminate();
+        return -1;
+    }
+    glfwMakeContextCurrent(window);
+
+    glewExperimental = GL_TRUE;
+    if (glewInit() != GLEW_OK)
+    {
+        return -1;
+    }
+
+    // defaults of the command line options of the simulation
+    params.cohesion_factor = 0.5f;
+    params.alignment_factor = 0.5f;
+    params.sight_dist = 50.f;
+    params.separation_dist = 25.f;
+
+    std::printf("%d boids, %u ticks, %u runs, %d processes%s\n", params.n, ticks, runs, params.processes, params.compact ? ", compact" : "");
+    std::printf("wrap  sight  separation     min (s)  median (s)     max (s)  moved (MB/s)\n");
+
+    std::size_t state = 0, upload = 0;
+    for (bool wrap : {false, true})
+    {
+        for (float sight_angle : {90.f, 360.f})
+        {
+            for (float separation : {0.f, 0.5f})
+            {
+                params.wrap = wrap;
+                params.sight_angle = sight_angle;
+                params.separation_factor = separation;
+
+                std::vector<double> times;
+                for (unsigned int r = 0; r < runs; ++r)
+                    times.push_back(time_updates(params, ticks, state, upload));
+                std::sort(times.begin(), times.end());
+
+                // bandwidth of the state and upload traffic at the median time
+                auto median = times[times.size() / 2];
+                std::printf("%4d  %5.0f  %10.1f  %10.3f  %10.3f  %10.3f  %12.1f\n",
+                            wrap, sight_angle, separation, times.front(), median, times.back(),
+                            1e-6 * (state + upload) * params.n * ticks / median);
+            }
+        }
+    }
+
+    std::printf("each update moves %zu bytes per boid, %zu of state and %zu uploaded\n", state + upload, state, upload);
+
+    glfwTerminate();
+    return 0;
+}
@@ -0,0 +1,131 @@
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+#include "flock.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <vector>
+
+// fixed dt, the same as the simulation steps with
+constexpr float CHECK_DT = 1.f / 60.f;
+constexpr float MAX_HALF = 65504.f;             // largest finite half float
+constexpr float MIN_NORMAL_HALF = 6.1035e-5f;   // smallest normal half float, 2^-14
+constexpr float HALF_ROUNDING = 1.f / 2048.f;   // largest relative rounding error of a normal half float, 2^-11
+constexpr float MAX_POSITION_ERROR = 0.1f;      // 99th percentile difference of a position after one update (pixels)
+constexpr float MAX_VELOCITY_ERROR = 0.01f;     // 99th percentile difference of a velocity after one update, relative to its speed
+constexpr float CHECKED_FRACTION = 0.99f;       // fraction of the boids held to the limits
+
+/// @brief check every half float survives a round trip through float
+/// and floats in the normal half range come back within the rounding error
+/// @return true if the conversions are correct
+static bool check_half_round_trip()
+{
+    unsigned int failures = 0;
+    for (unsigned int bits = 0; bits <= 0xffff; ++bits)
+    {
+        // infinities and nans have every exponent bit set
+        if ((bits & 0x7c00) == 0x7c00)
+            continue;
+        if (to_half(from_half(static_cast<GLhalf>(bits))) != bits)
+            ++failures;
+    }
+
+    float worst = 0.f;
+    for (float v = MIN_NORMAL_HALF; v <= MAX_HALF; v *= 1.0009f)
+    {
+        for (float s : {v, -v})
+            worst = std::max(worst, std::abs(from_half(to_half(s)) - s) / v);
+    }
+    if (worst > HALF_ROUNDING)
+        ++failures;
+
+    std::printf("half round trip: %u mismatches, largest relative error %.6f (limit %.6f)\n", failures, worst, HALF_ROUNDING);
+    return failures == 0;
+}
+
+/// @brief update a float and a compact flock once from the same start and compare them
+/// a few boids may differ a lot, rounding can move a neighbour across the edge of sight
+/// which turns a slow boid in another direction once it is pushed up to the min speed
+/// so the limits hold for most of the boids and the largest errors are only reported
+/// @param params parameters of both flocks
+/// @return true if the compact flock is within the error limits
+static bool check_one_update(Flock::parameters params)
+{
+    params.compact = false;
+    Flock exact(params);
+    params.compact = true;
+    Flock compact(params);
+
+    exact.update(CHECK_DT);
+    compact.update(CHECK_DT);
+
+    std::vector<vec2> exact_pos, exact_vel, compact_pos, compact_vel;
+    exact.get_state(exact_pos, exact_vel);
+    compact.get_state(compact_pos, compact_vel);
+
+    std::vector<float> pos_errors(exact_pos.size()), vel_errors(exact_pos.size());
+    for (std::size_t i = 0; i < exact_pos.size(); ++i)
+    {
+        pos_errors[i] = (compact_pos[i] - exact_pos[i]).mag();
+        vel_errors[i] = (compact_vel[i] - exact_vel[i]).mag() / exact_vel[i].mag();
+    }
+    std::sort(pos_errors.begin(), pos_errors.end());
+    std::sort(vel_errors.begin(), vel_errors.end());
+
+    auto checked = static_cast<std::size_t>(CHECKED_FRACTION * (pos_errors.size() - 1));
+    bool ok = pos_errors[checked] <= MAX_POSITION_ERROR && vel_errors[checked] <= MAX_VELOCITY_ERROR;
+    std::printf("one update, wrap %d, sight %3.0f: position error %.3f px (limit %.3f, max %.3f), "
+                "velocity error %.2f%% (limit %.2f%%, max %.2f%%) %s\n",
+                params.wrap, params.sight_angle, pos_errors[checked], MAX_POSITION_ERROR, pos_errors.back(),
+                100.f * vel_errors[checked], 100.f * MAX_VELOCITY_ERROR, 100.f * vel_errors.back(), ok ? "ok" : "FAILED");
+    return ok;
+}
+
+int main()
+{
+    // the flock creates its draw data so it needs a context, the window is never shown
+    if (!glfwInit())
+        return -1;
+
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+    glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+    GLFWwindow *window = glfwCreateWindow(800, 800, "Flocking Compact Check", NULL, NULL);
+    if (!window)
+    {
+        glfwTerminate();
+        return -1;
+    }
+    glfwMakeContextCurrent(window);
+
+    glewExperimental = GL_TRUE;
+    if (glewInit() != GLEW_OK)
+    {
+        return -1;
+    }
+
+    // defaults of the command line options of the simulation
+    Flock::parameters params;
+    params.cohesion_factor = 0.5f;
+    params.alignment_factor = 0.5f;
+    params.separation_factor = 0.5f;
+    params.n = 2000;
+    params.seed = 1;
+    params.sight_dist = 50.f;
+    params.separation_dist = 25.f;
+
+    bool ok = check_half_round_trip();
+    for (bool wrap : {false, true})
+    {
+        for (float sight_angle : {90.f, 360.f})
+        {
+            params.wrap = wrap;
+            params.sight_angle = sight_angle;
+            ok = check_one_update(params) && ok;
+        }
+    }
+
+    glfwTerminate();
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,119 @@
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+#include "flock.h"
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+// fixed dt, the same as the simulation steps with
+constexpr float CHECK_DT = 1.f / 60.f;
+constexpr unsigned int CHECK_TICKS = 60;   // updates compared for each configuration
+
+/// @brief check two states are bit identical
+/// @param a first states
+/// @param b second states
+/// @return true if they have the same size and bits
+static bool identical(const std::vector<vec2> &a, const std::vector<vec2> &b)
+{
+    return a.size() == b.size() && std::memcmp(a.data(), b.data(), a.size() * sizeof(vec2)) == 0;
+}
+
+/// @brief update a flock in this process and one split over tile workers side by side and compare every update
+/// a third of the way through n and the sight distance change, two thirds through n, sight, flee distance and wrap
+/// @param params parameters of both flocks, processes is the number of tile workers
+/// @return true if the two flocks stayed bit identical
+static bool check_tiles(Flock::parameters params)
+{
+    auto processes = params.processes;
+    params.processes = 1;
+    Flock single(params);
+    params.processes = processes;
+    Flock tiled(params);
+
+    std::vector<vec2> single_pos, single_vel, tiled_pos, tiled_vel;
+    for (unsigned int t = 1; t <= CHECK_TICKS; ++t)
+    {
+        if (t == CHECK_TICKS / 3 || t == 2 * CHECK_TICKS / 3)
+        {
+            auto changed = params;
+            changed.n = t == CHECK_TICKS / 3 ? params.n + params.n / 3 : params.n / 2;
+            changed.sight_dist = t == CHECK_TICKS / 3 ? 70.f : 40.f;
+            if (t == 2 * CHECK_TICKS / 3)
+            {
+                changed.flee_dist = 150.f;
+                changed.wrap = !params.wrap;
+            }
+            single.set_parameters(changed);
+            tiled.set_parameters(changed);
+        }
+
+        single.update(CHECK_DT);
+        tiled.update(CHECK_DT);
+
+        single.get_state(single_pos, single_vel);
+        tiled.get_state(tiled_pos, tiled_vel);
+        if (!identical(single_pos, tiled_pos) || !identical(single_vel, tiled_vel))
+        {
+            std::printf("%2d processes, wrap %d, sight %3.0f, wander %.1f, %d predators: differ after update %u FAILED\n",
+                        processes, params.wrap, params.sight_angle, params.wander_factor, params.predators, t);
+            return false;
+        }
+    }
+
+    std::printf("%2d processes, wrap %d, sight %3.0f, wander %.1f, %d predators: identical ok\n",
+                processes, params.wrap, params.sight_angle, params.wander_factor, params.predators);
+    return true;
+}
+
+int main()
+{
+    // the flock creates its draw data so it needs a context, the window is never shown
+    if (!glfwInit())
+        return -1;
+
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+    glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+    GLFWwindow *window = glfwCreateWindow(800, 800, "Flocking Tiles Check", NULL, NULL);
+    if (!window)
+    {
+        glfwTerminate();
+        return -1;
+    }
+    glfwMakeContextCurrent(window);
+
+    glewExperimental = GL_TRUE;
+    if (glewInit() != GLEW_OK)
+    {
+        return -1;
+    }
+
+    // defaults of the command line options of the simulation
+    Flock::parameters params;
+    params.cohesion_factor = 0.5f;
+    params.alignment_factor = 0.5f;
+    params.separation_factor = 0.5f;
+    params.n = 1000;
+    params.seed = 1;
+    params.sight_dist = 50.f;
+    params.separation_dist = 25.f;
+
+    // the order in which the workers hand boids to each other matters most with many thin tiles
+    bool ok = true;
+    for (int processes : {2, 3, 8, 32})
+    {
+        for (bool wrap : {false, true})
+        {
+            params.processes = processes;
+            params.wrap = wrap;
+            params.sight_angle = wrap ? 360.f : 90.f;
+            params.wander_factor = wrap ? 0.3f : 0.f;
+            params.predators = wrap ? 0 : 3;
+            ok = check_tiles(params) && ok;
+        }
+    }
+
+    glfwTerminate();
+    return ok ? 0 : 1;
+}
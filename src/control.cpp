@@ -0,0 +1,234 @@
+#include "control.h"
+#include <cerrno>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <sstream>
+#include <type_traits>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+// how often the server checks if it should stop (milliseconds)
+constexpr int POLL_TIMEOUT_MS = 100;
+
+ControlServer::ControlServer(Flock &flock, const Flock::parameters &params, const std::string &path) :
+    flock_(flock), params_(params), path_(path)
+{
+    sockaddr_un addr{};
+    addr.sun_family = AF_UNIX;
+    if (path_.size() >= sizeof(addr.sun_path))
+    {
+        std::cerr << "Control socket path is too long: " << path_ << '\n';
+        exit(1);
+    }
+    std::strcpy(addr.sun_path, path_.c_str());
+
+    socket_ = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    // remove a socket left behind by a previous run
+    ::unlink(path_.c_str());
+    if (socket_ < 0 ||
+        ::bind(socket_, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) < 0 ||
+        ::listen(socket_, 4) < 0)
+    {
+        std::cerr << "Could not create control socket " << path_ << ": " << std::strerror(errno) << '\n';
+        exit(1);
+    }
+
+    thread_ = std::thread(&ControlServer::serve, this);
+}
+
+ControlServer::~ControlServer()
+{
+    stop_ = true;
+    thread_.join();
+    ::close(socket_);
+    ::unlink(path_.c_str());
+}
+
+void ControlServer::serve()
+{
+    // the listening socket comes first, followed by every open connection
+    // so an idle connection never keeps the others waiting
+    std::vector<pollfd> fds;
+    while (!stop_)
+    {
+        fds.assign(1, {socket_, POLLIN, 0});
+        for (const auto &c : clients_)
+            fds.push_back({c.socket, POLLIN, 0});
+
+        if (::poll(fds.data(), fds.size(), POLL_TIMEOUT_MS) <= 0)
+            continue;
+
+        // fds lines up with the connections open before the poll, new ones are added after
+        std::size_t open = 0;
+        for (std::size_t i = 0; i < clients_.size(); ++i)
+        {
+            if ((fds[i + 1].revents & (POLLIN | POLLHUP | POLLERR)) && !handle_client(clients_[i]))
+            {
+                ::close(clients_[i].socket);
+                continue;
+            }
+            if (open != i)
+                clients_[open] = std::move(clients_[i]);
+            ++open;
+        }
+        clients_.resize(open);
+
+        if (fds[0].revents & POLLIN)
+        {
+            int socket = ::accept(socket_, nullptr, nullptr);
+            if (socket >= 0)
+                clients_.push_back({socket, {}});
+        }
+    }
+
+    for (const auto &c : clients_)
+        ::close(c.socket);
+    clients_.clear();
+}
+
+bool ControlServer::handle_client(client &c)
+{
+    char chunk[256];
+    auto received = ::recv(c.socket, chunk, sizeof(chunk), MSG_DONTWAIT);
+    if (received < 0)
+        return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+    if (received == 0)
+        return false;
+    c.buffer.append(chunk, received);
+
+    // run every complete line received so far
+    std::string::size_type end;
+    while ((end = c.buffer.find('\n')) != std::string::npos)
+    {
+        auto reply = run_command(c.buffer.substr(0, end)) + '\n';
+        c.buffer.erase(0, end + 1);
+        // never wait on a client, one which does not read its replies is dropped
+        auto sent = ::send(c.socket, reply.data(), reply.size(), MSG_NOSIGNAL | MSG_DONTWAIT);
+        if (sent != static_cast<ssize_t>(reply.size()))
+            return false;
+    }
+    return true;
+}
+
+std::string ControlServer::run_command(const std::string &line)
+{
+    std::istringstream in(line);
+    std::string command, target, value;
+    in >> command >> target >> value;
+
+    if (command == "set" && !target.empty() && !value.empty())
+        return set_parameter(target, value);
+
+    if (command == "get" && target == "params")
+    {
+        std::ostringstream out;
+        out << "cohesion " << params_.cohesion_factor << '\n'
+            << "alignment " << params_.alignment_factor << '\n'
+            << "separation " << params_.separation_factor << '\n'
+            << "n " << params_.n << '\n'
+            << "sight-distance " << params_.sight_dist << '\n'
+            << "sight-angle " << params_.sight_angle << '\n'
+            << "separation-distance " << params_.separation_dist << '\n'
+            << "wander " << params_.wander_factor << '\n'
+            << "flee-distance " << params_.flee_dist << '\n'
+            << "wrap " << params_.wrap;
+        return out.str();
+    }
+
+    if (command == "get" && target == "stats")
+    {
+        auto stats = flock_.get_stats();
+        std::ostringstream out;
+        out << "ticks " << stats.ticks << '\n'
+            << "boids " << stats.count << '\n'
+            << "update-ms " << stats.update_ms;
+        return out.str();
+    }
+
+    return "error: unknown command, expected 'set <option> <value>', 'get params' or 'get stats'";
+}
+
+// parse a whole string as a number
+// fails on trailing characters and on values which do not fit in the type
+template <typename T>
+static bool parse_number(const std::string &text, T &v)
+{
+    try
+    {
+        std::size_t used;
+        if constexpr (std::is_integral_v<T>)
+            v = std::stoi(text, &used);
+        else
+            v = std::stof(text, &used);
+        return used == text.size();
+    }
+    catch (std::exception &)
+    {
+        return false;
+    }
+}
+
+std::string ControlServer::set_parameter(const std::string &option, const std::string &value)
+{
+    const std::string invalid = "error: the argument ('" + value + "') for option '" + option + "' is invalid";
+
+    // whole number options are parsed as integers so large counts are neither rounded nor overflow
+    if (option == "n" || option == "wrap")
+    {
+        int v;
+        if (!parse_number(value, v))
+            return "error: invalid value " + value;
+
+        int min = option == "n" ? 1 : 0;
+        int max = option == "n" ? MAX_BOIDS : 1;
+        if (v < min || v > max)
+            return invalid;
+
+        if (option == "n")
+            params_.n = v;
+        else
+            params_.wrap = v != 0;
+
+        flock_.set_parameters(params_);
+        return "ok";
+    }
+
+    float min = 0.f, max = INFINITY;
+    if (option == "cohesion" || option == "alignment" || option == "separation" || option == "wander")
+        max = 1.f;
+    else if (option == "sight-angle")
+        max = 360.f;
+    else if (option != "sight-distance" && option != "separation-distance" && option != "flee-distance")
+        return "error: unknown option " + option;
+
+    float v;
+    if (!parse_number(value, v))
+        return "error: invalid value " + value;
+
+    // written so that nan fails the check as well
+    if (!(v >= min && v <= max))
+        return invalid;
+
+    if (option == "cohesion")
+        params_.cohesion_factor = v;
+    else if (option == "alignment")
+        params_.alignment_factor = v;
+    else if (option == "separation")
+        params_.separation_factor = v;
+    else if (option == "sight-distance")
+        params_.sight_dist = v;
+    else if (option == "sight-angle")
+        params_.sight_angle = v;
+    else if (option == "separation-distance")
+        params_.separation_dist = v;
+    else if (option == "wander")
+        params_.wander_factor = v;
+    else if (option == "flee-distance")
+        params_.flee_dist = v;
+
+    flock_.set_parameters(params_);
+    return "ok";
+}
@@ -0,0 +1,68 @@
+#ifndef control_hpp
+#define control_hpp
+
+#include "flock.h"
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
+/// @brief unix socket which changes the parameters of a running flock and reports its statistics
+///
+/// each line sent to the socket is one command:
+///   set <option> <value>   change a parameter, options use the command line names
+///   get params             list the current parameters
+///   get stats              report the statistics of the simulation
+class ControlServer
+{
+public:
+    /// @brief ControlServer constructor, starts listening on the socket
+    /// @param flock flock to control, must outlive the server
+    /// @param params parameters the flock was created with
+    /// @param path path of the unix socket to create
+    ControlServer(Flock &flock, const Flock::parameters &params, const std::string &path);
+
+    /// @brief stops the server and removes the socket
+    ~ControlServer();
+
+    ControlServer(const ControlServer &) = delete;
+    ControlServer &operator=(const ControlServer &) = delete;
+
+private:
+    /// @brief struct for an open connection
+    struct client
+    {
+        int socket;
+        std::string buffer;   // received bytes not yet ending in a newline
+    };
+
+    /// @brief accept connections and serve every open one until the server is stopped
+    void serve();
+
+    /// @brief run the commands received on a connection which is ready to read
+    /// @param c the connection
+    /// @return false if the connection was closed and should be dropped
+    bool handle_client(client &c);
+
+    /// @brief run a single command
+    /// @param line the command
+    /// @return the reply to send back
+    std::string run_command(const std::string &line);
+
+    /// @brief change a parameter and send the result to the flock
+    /// @param option name of the parameter
+    /// @param value new value of the parameter
+    /// @return the reply to send back
+    std::string set_parameter(const std::string &option, const std::string &value);
+
+private:
+    Flock &flock_;
+    Flock::parameters params_;   // only touched by the server thread
+    std::string path_;
+    int socket_;
+    std::vector<client> clients_;   // only touched by the server thread
+    std::atomic<bool> stop_ = false;
+    std::thread thread_;
+};
+
+#endif
@@ -1,4 +1,11 @@
+#define _USE_MATH_DEFINES
 #include "flock.h"
+#include "socket_tiles.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <memory>
+#include <new>
 #include <random>
 #include <iostream>
 
@@ -9,6 +16,15 @@ constexpr GLfloat MIN_SPEED = 200.f;           // the min speed of a boid
 constexpr GLfloat SCREEN_MARGIN = 250.f;       // if not wrapping, the distance to the edge of a screen before boid is nudge away
 constexpr GLfloat SCREEN_NUDGE_WEIGHT = 7.f;   // weight to nudge a boid away from edge of screen
 constexpr GLfloat RULE_SCALE_FACTOR = 20.f;    // the base scale factor for any influence of a rule
+constexpr GLfloat PACK_SCALE = 65535.f;        // largest value of a 16 bit fixed point position
+constexpr GLfloat PREDATOR_MAX_SPEED = 350.f;  // the max speed of a predator, slower than boids so they can escape
+constexpr GLfloat FLEE_WEIGHT = 1.f;           // scale of the force pushing a boid away from predators
+constexpr GLfloat CHASE_WEIGHT = 1.f;          // scale of the force steering a predator to its target
+constexpr unsigned int SPAWN_BATCH = 256;      // boids given random starting values at once
+constexpr std::uint32_t SPAWN_STREAM = 0;      // random stream for starting positions and velocities
+constexpr std::uint32_t WANDER_STREAM = 1;     // random stream for the wander force
+constexpr GLfloat HALO_MARGIN = 1.f;           // extra width of a tile halo so rounding never leaves out a boid in sight
+constexpr float TILE_IMBALANCE = 1.25f;        // tiles are rebalanced once one holds this many times its share of boids
 
 void Flock::create_draw_data()
 {
@@ -37,53 +53,138 @@ void Flock::create_draw_data()
     glEnableVertexAttribArray(0); // store layout at location 0 for shader
     glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(GLfloat), 0);
 
-    // position buffer
-    glGenBuffers(1, &pos_buffer_);
-    glBindBuffer(GL_ARRAY_BUFFER, pos_buffer_);
-    glBufferData(GL_ARRAY_BUFFER, count_ * sizeof(vec2), positions_.data(), GL_DYNAMIC_DRAW);
+    if (params_.compact)
+    {
+        // position buffer as normalized shorts, scaled to pixels in the shader
+        glGenBuffers(1, &pos_buffer_);
+        glBindBuffer(GL_ARRAY_BUFFER, pos_buffer_);
+        glBufferData(GL_ARRAY_BUFFER, packed_positions_.size() * sizeof(packed_pos), packed_positions_.data(), GL_DYNAMIC_DRAW);
+
+        glEnableVertexAttribArray(1); // store layout at location 1 for shader
+        glVertexAttribPointer(1, 2, GL_UNSIGNED_SHORT, GL_TRUE, sizeof(packed_pos), 0);
+        glVertexAttribDivisor(1, 1); // every position will be used for a single base shape
+
+        // the rotation is computed from the velocity in the shader
+        // so the rotation buffer holds the half float velocities
+        glGenBuffers(1, &rotation_buffer_);
+        glBindBuffer(GL_ARRAY_BUFFER, rotation_buffer_);
+        glBufferData(GL_ARRAY_BUFFER, packed_velocities_.size() * sizeof(packed_vel), packed_velocities_.data(), GL_DYNAMIC_DRAW);
+
+        glEnableVertexAttribArray(2); // store layout at location 2 in shader
+        glVertexAttribPointer(2, 2, GL_HALF_FLOAT, GL_FALSE, sizeof(packed_vel), 0);
+        glVertexAttribDivisor(2, 1); // each velocity used for for a single base shape
+    }
+    else
+    {
+        // position buffer
+        glGenBuffers(1, &pos_buffer_);
+        glBindBuffer(GL_ARRAY_BUFFER, pos_buffer_);
+        glBufferData(GL_ARRAY_BUFFER, positions_.size() * sizeof(vec2), positions_.data(), GL_DYNAMIC_DRAW);
+
+        glEnableVertexAttribArray(1); // store layout at location 1 for shader
+        glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, sizeof(vec2), 0);
+        glVertexAttribDivisor(1, 1); // every position will be used for a single base shape
+
+        // rotation buffer
+        glGenBuffers(1, &rotation_buffer_);
+        glBindBuffer(GL_ARRAY_BUFFER, rotation_buffer_);
+        glBufferData(GL_ARRAY_BUFFER, rotations_.size() * sizeof(mat2), rotations_.data(), GL_DYNAMIC_DRAW);
+
+        glEnableVertexAttribArray(2); // store layout at location 2 in shader
+        glEnableVertexAttribArray(3); // must use two separate layouts for matrix
+        glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(mat2), 0);
+        glVertexAttribPointer(3, 2, GL_FLOAT, GL_FALSE, sizeof(mat2), (void*)(sizeof(GLfloat) * 2));
+        glVertexAttribDivisor(2, 1); // each rotation used for for a single base shape
+        glVertexAttribDivisor(3, 1);
+    }
 
-    glEnableVertexAttribArray(1); // store layout at location 1 for shader
-    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, sizeof(vec2), 0);
-    glVertexAttribDivisor(1, 1); // every position will be used for a single base shape
+    // type buffer so predators can be drawn differently in the same draw call
+    glGenBuffers(1, &type_buffer_);
+    upload_types();
 
-    // rotation buffer
-    glGenBuffers(1, &rotation_buffer_);
-    glBindBuffer(GL_ARRAY_BUFFER, rotation_buffer_);
-    glBufferData(GL_ARRAY_BUFFER, count_ * sizeof(mat2), rotations_.data(), GL_DYNAMIC_DRAW);
+    glEnableVertexAttribArray(4); // store layout at location 4 in shader
+    glVertexAttribPointer(4, 1, GL_FLOAT, GL_FALSE, sizeof(GLfloat), 0);
+    glVertexAttribDivisor(4, 1); // each type used for a single base shape
+}
 
-    glEnableVertexAttribArray(2); // store layout at location 2 in shader
-    glEnableVertexAttribArray(3); // must use two separate layouts for matrix
-    glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(mat2), 0);
-    glVertexAttribPointer(3, 2, GL_FLOAT, GL_FALSE, sizeof(mat2), (void*)(sizeof(GLfloat) * 2));
-    glVertexAttribDivisor(2, 1); // each rotation used for for a single base shape
-    glVertexAttribDivisor(3, 1);
+void Flock::upload_types() const
+{
+    // boids come first followed by the predators
+    std::vector<GLfloat> types(count_ + predators_, 0.f);
+    std::fill(types.begin() + count_, types.end(), 1.f);
+
+    glBindBuffer(GL_ARRAY_BUFFER, type_buffer_);
+    glBufferData(GL_ARRAY_BUFFER, types.size() * sizeof(GLfloat), types.data(), GL_STATIC_DRAW);
+}
+
+template <typename Order>
+void Flock::run_rules(Order order)
+{
+    // pick the rules kernel once so the per boid loop has no branches on the parameters
+    // angle_between never exceeds 180 degrees so any wider field of view sees every direction
+    bool full_sight = params_.sight_angle >= 180.f;
+    bool separation = params_.separation_factor != 0.f;
+    bool wander = params_.wander_factor != 0.f;
+    bool predators = predators_ != 0;
+
+    dispatch_rules(order, params_.wrap, full_sight, separation, wander, predators, params_.compact);
+}
+
+template <bool... Policies, typename Order, typename... Flags>
+void Flock::dispatch_rules(Order order, bool flag, Flags... rest)
+{
+    if constexpr (sizeof...(rest) == 0)
+        flag ? apply_rules<Policies..., true>(order) : apply_rules<Policies..., false>(order);
+    else
+        flag ? dispatch_rules<Policies..., true>(order, rest...) : dispatch_rules<Policies..., false>(order, rest...);
+}
+
+template <bool Wrap, bool FullSight, bool Separation, bool Wander, bool Predators, bool Compact, typename Order>
+void Flock::apply_rules(Order order)
+{
+    order([this](unsigned int i)
+    {
+        apply_rules_to_boid<Wrap, FullSight, Separation, Wander, Predators, Compact>(i);
+    });
 }
 
 // long function but more performant than separate functions for each rule
 // where 3 separate loops would be required
+template <bool Wrap, bool FullSight, bool Separation, bool Wander, bool Predators, bool Compact>
 void Flock::apply_rules_to_boid(unsigned int i)
 {
     vec2 avg_pos, avg_heading, repel;
     int num_neighbors = 0;
 
-    for (unsigned int j = 0; j < count_; ++j)
+    // steering runs on unpacked copies which are stored back once the boid is done
+    auto pos = position<Compact>(i);
+    auto vel = velocity<Compact>(i);
+
+    // only boids in the surrounding tiles can be within sight
+    grid_.query(pos, neighbors_);
+
+    for (auto j : neighbors_)
     {
         if (j == i)
             continue;
 
-        if (within_sight(i, j))
+        auto other = position<Compact>(j);
+        if (within_sight<FullSight>(pos, other))
         {
-            vec2 dist_vec = positions_[i] - positions_[j];
-            auto dist = dist_vec.mag();
-            if (dist <= params_.separation_dist * params_.separation_dist)
+            if constexpr (Separation)
             {
-                // the repelling force is inversely proportional to the distance
-                // closer boids should repel more than ones further away
-                repel += dist_vec / dist;
+                vec2 dist_vec = pos - other;
+                auto dist = dist_vec.mag();
+                if (dist > 0 && dist <= params_.separation_dist * params_.separation_dist)
+                {
+                    // the repelling force is inversely proportional to the distance
+                    // closer boids should repel more than ones further away
+                    repel += dist_vec / dist;
+                }
             }
 
-            avg_pos += positions_[j];
-            avg_heading += velocities_[j];
+            avg_pos += other;
+            avg_heading += velocity<Compact>(j);
             ++num_neighbors;
         }
     }
@@ -94,53 +195,216 @@ void Flock::apply_rules_to_boid(unsigned int i)
         avg_heading /= num_neighbors;
 
         // apply cohesion
-        velocities_[i] += ((avg_pos - positions_[i]).normalize() * RULE_SCALE_FACTOR * params_.cohesion_factor).limit(MAX_FORCE);
+        vel += ((avg_pos - pos).normalize() * RULE_SCALE_FACTOR * params_.cohesion_factor).limit(MAX_FORCE);
         // apply alignment
-        velocities_[i] += ((avg_heading - velocities_[i]).normalize() * RULE_SCALE_FACTOR * params_.alignment_factor).limit(MAX_FORCE);
+        vel += ((avg_heading - vel).normalize() * RULE_SCALE_FACTOR * params_.alignment_factor).limit(MAX_FORCE);
         // apply separation
-        velocities_[i] += (repel.normalize() * RULE_SCALE_FACTOR * params_.separation_factor).limit(MAX_FORCE);
+        if constexpr (Separation)
+            vel += (repel.normalize() * RULE_SCALE_FACTOR * params_.separation_factor).limit(MAX_FORCE);
+    }
+
+    if constexpr (Wander)
+    {
+        // steer in a random direction drawn for this boid and tick
+        auto r = rng_(Philox::counter(i, tick_, WANDER_STREAM));
+        float theta = 2.f * static_cast<float>(M_PI) * Philox::to_unit(r[0]);
+        vel += (vec2(std::cos(theta), std::sin(theta)) * RULE_SCALE_FACTOR * params_.wander_factor).limit(MAX_FORCE);
+    }
+
+    if constexpr (Predators)
+    {
+        // only predators in the surrounding tiles can be within the flee distance
+        predator_grid_.query(pos, threats_);
+
+        vec2 flee;
+        for (auto j : threats_)
+        {
+            vec2 away = pos - position<Compact>(j);
+            auto dist = away.mag();
+            if (dist > 0 && dist <= params_.flee_dist)
+            {
+                // closer predators are fled from more strongly
+                flee += away / dist;
+            }
+        }
+        vel += (flee.normalize() * RULE_SCALE_FACTOR * FLEE_WEIGHT).limit(MAX_FORCE);
     }
 
-    params_.wrap ? wrap(i) : nudge_inside_margin(i);
+    if constexpr (Wrap)
+    {
+        auto old_pos = pos;
+        wrap(pos);
+        set_position<Compact>(i, pos);
+
+        // boids checked later in this update must see the wrapped position
+        grid_.move(i, old_pos, pos);
+    }
+    else
+        nudge_inside_margin(pos, vel);
 
-    auto speed = velocities_[i].mag();
+    auto speed = vel.mag();
     // enforce minimum speed
     if(speed < MIN_SPEED)
     {
-        velocities_[i].normalize();
-        velocities_[i] *= MIN_SPEED;
+        vel.normalize();
+        vel *= MIN_SPEED;
     }
     // enforce maximum speed
     if(speed > MAX_SPEED)
     {
-        velocities_[i].normalize();
-        velocities_[i] *= MAX_SPEED;
+        vel.normalize();
+        vel *= MAX_SPEED;
+    }
+
+    set_velocity<Compact>(i, vel);
+}
+
+template <bool Wrap, bool Compact>
+void Flock::apply_predator_rules()
+{
+    auto boid_position = [this](unsigned int j) { return position<Compact>(j); };
+
+    for (unsigned int i = count_; i < count_ + predators_; ++i)
+    {
+        auto pos = position<Compact>(i);
+        auto vel = velocity<Compact>(i);
+
+        // steer towards the closest boid
+        unsigned int target;
+        if (grid_.nearest(pos, boid_position, target))
+            vel += ((position<Compact>(target) - pos).normalize() * RULE_SCALE_FACTOR * CHASE_WEIGHT).limit(MAX_FORCE);
+
+        if constexpr (Wrap)
+        {
+            wrap(pos);
+            set_position<Compact>(i, pos);
+        }
+        else
+            nudge_inside_margin(pos, vel);
+
+        // enforce minimum speed
+        if(vel.mag() < MIN_SPEED)
+        {
+            vel.normalize();
+            vel *= MIN_SPEED;
+        }
+        vel.limit(PREDATOR_MAX_SPEED);
+
+        set_velocity<Compact>(i, vel);
+    }
+}
+
+template <bool Compact>
+void Flock::apply_velocities(float dt)
+{
+    for (unsigned int i = 0; i < count_ + predators_; ++i)
+    {
+        auto vel = velocity<Compact>(i);
+        // compact boids are rotated in the shader
+        if constexpr (!Compact)
+            rotations_[i] = rotation_matrix(std::atan2(vel[1], vel[0]));
+        vel.limit(MAX_SPEED);
+        set_velocity<Compact>(i, vel);
+        set_position<Compact>(i, position<Compact>(i) + vel * dt);
+    }
+}
+
+template <bool Compact>
+vec2 Flock::position(unsigned int i) const
+{
+    if constexpr (Compact)
+    {
+        const auto &p = packed_positions_[i];
+        return vec2(
+            pack_origin_[0] + p[0] * (pack_extent_[0] / PACK_SCALE),
+            pack_origin_[1] + p[1] * (pack_extent_[1] / PACK_SCALE));
     }
+    else
+        return positions_[i];
+}
+
+template <bool Compact>
+vec2 Flock::velocity(unsigned int i) const
+{
+    if constexpr (Compact)
+        return vec2(from_half(packed_velocities_[i][0]), from_half(packed_velocities_[i][1]));
+    else
+        return velocities_[i];
+}
+
+template <bool Compact>
+void Flock::set_position(unsigned int i, const vec2 &pos)
+{
+    if constexpr (Compact)
+    {
+        // boids outside the quantization bounds are held at the edge
+        auto pack = [](float v, float origin, float extent)
+        {
+            float t = (v - origin) / extent * PACK_SCALE + 0.5f;
+            return static_cast<GLushort>(std::clamp(t, 0.f, PACK_SCALE));
+        };
+        packed_positions_[i] = {
+            pack(pos[0], pack_origin_[0], pack_extent_[0]),
+            pack(pos[1], pack_origin_[1], pack_extent_[1])};
+    }
+    else
+        positions_[i] = pos;
+}
+
+template <bool Compact>
+void Flock::set_velocity(unsigned int i, const vec2 &vel)
+{
+    if constexpr (Compact)
+        packed_velocities_[i] = {to_half(vel[0]), to_half(vel[1])};
+    else
+        velocities_[i] = vel;
 }
 
 void Flock::draw() const
 {
-    glDrawArraysInstanced(GL_TRIANGLES, 0, 3, count_);
+    glDrawArraysInstanced(GL_TRIANGLES, 0, 3, count_ + predators_);
+}
+
+void Flock::set_uniforms(GLuint shader_program) const
+{
+    if (params_.compact)
+    {
+        GLuint origin_loc = glGetUniformLocation(shader_program, "u_pack_origin");
+        GLuint extent_loc = glGetUniformLocation(shader_program, "u_pack_extent");
+        glUniform2f(origin_loc, pack_origin_[0], pack_origin_[1]);
+        glUniform2f(extent_loc, pack_extent_[0], pack_extent_[1]);
+    }
 }
 
 void Flock::update_draw_data() const
 {
+    if (params_.compact)
+    {
+        glBindBuffer(GL_ARRAY_BUFFER, pos_buffer_);
+        glBufferSubData(GL_ARRAY_BUFFER, 0, packed_positions_.size() * sizeof(packed_pos), packed_positions_.data());
+
+        glBindBuffer(GL_ARRAY_BUFFER, rotation_buffer_);
+        glBufferSubData(GL_ARRAY_BUFFER, 0, packed_velocities_.size() * sizeof(packed_vel), packed_velocities_.data());
+        return;
+    }
+
     // update position buffer with positions
     glBindBuffer(GL_ARRAY_BUFFER, pos_buffer_);
-    glBufferSubData(GL_ARRAY_BUFFER, 0, count_ * sizeof(vec2), positions_.data());
+    glBufferSubData(GL_ARRAY_BUFFER, 0, positions_.size() * sizeof(vec2), positions_.data());
 
     // update rotation buffer with rotations
     glBindBuffer(GL_ARRAY_BUFFER, rotation_buffer_);
-    glBufferSubData(GL_ARRAY_BUFFER, 0, count_ * sizeof(mat2), rotations_.data());
+    glBufferSubData(GL_ARRAY_BUFFER, 0, rotations_.size() * sizeof(mat2), rotations_.data());
 }
 
-bool Flock::within_sight(unsigned int source, unsigned int other) const
+template <bool FullSight>
+bool Flock::within_sight(const vec2 &source, const vec2 &other) const
 {
-    auto diff = positions_[source] - positions_[other];
+    auto diff = source - other;
     if(
         std::abs(diff[0]) <= params_.sight_dist && 
         std::abs(diff[1]) <= params_.sight_dist && 
-        positions_[source].angle_between(diff) <= params_.sight_angle)
+        (FullSight || source.angle_between(diff) <= params_.sight_angle))
     {
         if (diff.squared_mag() <= params_.sight_dist * params_.sight_dist)
         {
@@ -153,54 +417,465 @@ bool Flock::within_sight(unsigned int source, unsigned int other) const
 
 void Flock::update(float dt)
 {
-    // update all forces acting on each boid
-    for (unsigned int i = 0; i < count_; ++i)
+    auto start = std::chrono::steady_clock::now();
+
+    // pick up parameters changed since the last update
+    // the exchange is the only synchronization so the rest of the update never waits
+    std::unique_ptr<const parameters> next(pending_params_.exchange(nullptr));
+    if (next)
+        apply_parameters(*next);
+
+    bool predators = predators_ != 0;
+    if (tiles_)
+    {
+        // the tile workers update the boids, the predators need the updated boids in the grid
+        update_tiles();
+
+        if (predators)
+        {
+            grid_.clear();
+            for (unsigned int i = 0; i < count_; ++i)
+                grid_.insert(i, positions_[i]);
+        }
+    }
+    else
     {
-        apply_rules_to_boid(i);
+        // bin boids into tiles so each boid only checks nearby boids
+        grid_.clear();
+        for (unsigned int i = 0; i < count_; ++i)
+        {
+            grid_.insert(i, params_.compact ? position<true>(i) : position<false>(i));
+        }
+
+        // predators are kept in their own grid so boids only look for the few predators nearby
+        predator_grid_.clear();
+        for (unsigned int i = count_; i < count_ + predators_; ++i)
+        {
+            predator_grid_.insert(i, params_.compact ? position<true>(i) : position<false>(i));
+        }
+
+        // update all forces acting on each boid
+        run_rules([this](auto rule)
+        {
+            for (unsigned int i = 0; i < count_; ++i)
+                rule(i);
+        });
     }
 
+    // predators chase the boids after the boids have reacted to them
+    if (predators && params_.compact)
+        params_.wrap ? apply_predator_rules<true, true>() : apply_predator_rules<false, true>();
+    else if (predators)
+        params_.wrap ? apply_predator_rules<true, false>() : apply_predator_rules<false, false>();
+
     // apply forces to each boid
+    params_.compact ? apply_velocities<true>(dt) : apply_velocities<false>(dt);
+
+    update_draw_data();
+
+    std::chrono::duration<float, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+    update_ms_ = elapsed.count();
+    stats_count_ = count_;
+    ticks_ = ++tick_;
+}
+
+void Flock::update_tiles()
+{
+    auto tiles = tiles_->size();
+    auto tile_of = [this](float x)
+    {
+        return static_cast<unsigned int>(std::upper_bound(tile_bounds_.begin(), tile_bounds_.end(), x) - tile_bounds_.begin());
+    };
+
+    // the tiles follow the boids as they drift so every worker has about the same amount of work
+    std::vector<unsigned int> counts(tiles, 0);
     for (unsigned int i = 0; i < count_; ++i)
+        ++counts[tile_of(positions_[i][0])];
+    if (tile_bounds_.size() + 1 != tiles || *std::max_element(counts.begin(), counts.end()) > TILE_IMBALANCE * count_ / tiles)
+        balance_tiles();
+
+    // every tile within sight of a position, as a mask
+    float reach = params_.sight_dist + HALO_MARGIN;
+    auto tiles_in_sight = [&](float x)
+    {
+        std::uint32_t mask = 0;
+        for (auto t = tile_of(x - reach); t <= tile_of(x + reach); ++t)
+            mask |= 1u << t;
+        return mask;
+    };
+
+    auto make_tile_boid = [this](unsigned int i, std::uint32_t tiles)
+    {
+        return tile_boid{i, tiles, {positions_[i][0], positions_[i][1]}, {velocities_[i][0], velocities_[i][1]}};
+    };
+
+    tile_owned_.resize(tiles);
+    tile_halo_.resize(tiles);
+    for (unsigned int t = 0; t < tiles; ++t)
     {
-        rotations_[i] = rotation_matrix(std::atan2(velocities_[i][1], velocities_[i][0]));
-        velocities_[i].limit(MAX_SPEED);
-        positions_[i] += velocities_[i] * dt;
+        tile_owned_[t].clear();
+        tile_halo_[t].clear();
     }
 
-    update_draw_data();
+    // a boid belongs to the tile holding its x coordinate
+    // and is copied into the halo of every other tile it can be seen from, before or after it wraps
+    // boids are visited in index order so every list stays sorted
+    for (unsigned int i = 0; i < count_; ++i)
+    {
+        auto pos = positions_[i];
+        auto owner = tile_of(pos[0]);
+
+        auto halo = tiles_in_sight(pos[0]);
+        if (params_.wrap)
+        {
+            wrap(pos);
+            halo |= tiles_in_sight(pos[0]);
+        }
+        halo &= ~(1u << owner);
+
+        tile_owned_[owner].push_back(make_tile_boid(i, halo));
+        for (unsigned int t = 0; t < tiles; ++t)
+        {
+            if (halo & (1u << t))
+                tile_halo_[t].push_back(make_tile_boid(i, owner));
+        }
+    }
+
+    tile_predators_.clear();
+    for (unsigned int i = count_; i < count_ + predators_; ++i)
+        tile_predators_.push_back(make_tile_boid(i, 0));
+
+    // every worker gets its boids before any result is read so they all run at the same time
+    for (unsigned int t = 0; t < tiles; ++t)
+    {
+        tile_update header{params_, tick_, count_, predators_,
+                           static_cast<unsigned int>(tile_owned_[t].size()), static_cast<unsigned int>(tile_halo_[t].size())};
+        tiles_->write(t, &header, sizeof(header));
+        tiles_->write(t, tile_owned_[t].data(), tile_owned_[t].size() * sizeof(tile_boid));
+        tiles_->write(t, tile_halo_[t].data(), tile_halo_[t].size() * sizeof(tile_boid));
+        tiles_->write(t, tile_predators_.data(), tile_predators_.size() * sizeof(tile_boid));
+    }
+
+    for (unsigned int t = 0; t < tiles; ++t)
+    {
+        tiles_->read(t, tile_owned_[t].data(), tile_owned_[t].size() * sizeof(tile_boid));
+        for (const auto &b : tile_owned_[t])
+        {
+            positions_[b.index] = vec2(b.pos[0], b.pos[1]);
+            velocities_[b.index] = vec2(b.vel[0], b.vel[1]);
+        }
+    }
 }
 
-Flock::Flock(const parameters &params) : 
-    params_(params),count_(params.n), positions_(params.n), velocities_(params.n), rotations_(params.n)
+void Flock::balance_tiles()
 {
-    // generate random starting positions for agents in flock
-    std::random_device rd;
-    std::mt19937 generator(rd());
-    if (params_.seed)
-        generator.seed(params_.seed);
-    
-    std::uniform_real_distribution<float> rng(0.f, 1.f);
+    auto tiles = tiles_->size();
+    std::vector<float> xs(count_);
+    for (unsigned int i = 0; i < count_; ++i)
+        xs[i] = positions_[i][0];
+
+    // each edge is the x coordinate splitting off the next equal share of boids
+    tile_bounds_.resize(tiles - 1);
+    auto first = xs.begin();
+    for (unsigned int t = 1; t < tiles; ++t)
+    {
+        auto nth = xs.begin() + static_cast<std::size_t>(count_) * t / tiles;
+        std::nth_element(first, nth, xs.end());
+        tile_bounds_[t - 1] = *nth;
+        first = nth;
+    }
+}
+
+void Flock::serve_tile(TileLink &link)
+{
+    tile_update header;
+    std::vector<tile_boid> owned, halo;
+
+    auto store = [this](const tile_boid &b)
+    {
+        positions_[b.index] = vec2(b.pos[0], b.pos[1]);
+        velocities_[b.index] = vec2(b.vel[0], b.vel[1]);
+    };
+
+    while (link.read(&header, sizeof(header)))
+    {
+        owned.resize(header.owned);
+        halo.resize(header.halo);
+        tile_predators_.resize(header.predators);
+        link.read(owned.data(), owned.size() * sizeof(tile_boid));
+        link.read(halo.data(), halo.size() * sizeof(tile_boid));
+        link.read(tile_predators_.data(), tile_predators_.size() * sizeof(tile_boid));
+
+        // the worker only stores the boids it was sent, at their index in the flock
+        if (header.params.sight_dist != params_.sight_dist)
+            grid_ = SpatialGrid(header.params.width, header.params.height, header.params.sight_dist);
+        if (header.params.flee_dist != params_.flee_dist)
+            predator_grid_ = SpatialGrid(header.params.width, header.params.height, header.params.flee_dist);
+        params_ = header.params;
+        tick_ = header.tick;
+        count_ = header.count;
+        predators_ = header.predators;
+        positions_.resize(count_ + predators_);
+        velocities_.resize(count_ + predators_);
+
+        grid_.clear();
+        for (const auto &b : owned)
+        {
+            store(b);
+            grid_.insert(b.index, positions_[b.index]);
+        }
+        for (const auto &b : halo)
+        {
+            store(b);
+            grid_.insert(b.index, positions_[b.index]);
+        }
+
+        predator_grid_.clear();
+        for (const auto &b : tile_predators_)
+        {
+            store(b);
+            predator_grid_.insert(b.index, positions_[b.index]);
+        }
+
+        // a single process updates the boids in index order and later boids see the updated earlier ones
+        // so before a boid is updated every halo boid with a lower index is replaced by its update from
+        // the worker owning it, and a halo boid with a higher index keeps the state it had before the update
+        std::size_t next_halo = 0;
+        auto take_halo = [&]()
+        {
+            tile_boid done;
+            link.next(halo[next_halo].tiles, done);
+
+            auto old_pos = positions_[done.index];
+            store(done);
+            grid_.move(done.index, old_pos, positions_[done.index]);
+            ++next_halo;
+        };
+
+        run_rules([&](auto rule)
+        {
+            for (auto &b : owned)
+            {
+                while (next_halo < halo.size() && halo[next_halo].index < b.index)
+                    take_halo();
+
+                rule(b.index);
+
+                b = tile_boid{b.index, b.tiles, {positions_[b.index][0], positions_[b.index][1]},
+                              {velocities_[b.index][0], velocities_[b.index][1]}};
+                for (unsigned int t = 0; t < MAX_TILES; ++t)
+                {
+                    if (b.tiles & (1u << t))
+                        link.post(t, b);
+                }
+            }
 
+            // the rest are only taken to keep the connections in step for the next update
+            while (next_halo < halo.size())
+                take_halo();
+        });
+
+        link.flush();
+        link.write(owned.data(), owned.size() * sizeof(tile_boid));
+    }
+}
+
+void Flock::set_parameters(const parameters &params)
+{
+    delete pending_params_.exchange(new parameters(params));
+}
+
+Flock::stats Flock::get_stats() const
+{
+    return {ticks_, stats_count_, update_ms_};
+}
+
+void Flock::get_state(std::vector<vec2> &positions, std::vector<vec2> &velocities) const
+{
+    positions.resize(count_ + predators_);
+    velocities.resize(count_ + predators_);
+    for (unsigned int i = 0; i < count_ + predators_; ++i)
+    {
+        positions[i] = params_.compact ? position<true>(i) : position<false>(i);
+        velocities[i] = params_.compact ? velocity<true>(i) : velocity<false>(i);
+    }
+}
+
+std::size_t Flock::state_bytes() const
+{
+    if (params_.compact)
+        return sizeof(packed_pos) + sizeof(packed_vel);
+    return 2 * sizeof(vec2) + sizeof(mat2);
+}
+
+std::size_t Flock::upload_bytes() const
+{
+    if (params_.compact)
+        return sizeof(packed_pos) + sizeof(packed_vel);
+    return sizeof(vec2) + sizeof(mat2);
+}
+
+void Flock::apply_parameters(const parameters &params)
+{
+    auto previous = params_;
+    params_ = params;
+
+    // the window and storage are created for these so they can not change
+    params_.width = previous.width;
+    params_.height = previous.height;
+    params_.compact = previous.compact;
+    params_.predators = previous.predators;
+    params_.processes = previous.processes;
+
+    if (params_.sight_dist != previous.sight_dist)
+        grid_ = SpatialGrid(params_.width, params_.height, params_.sight_dist);
+
+    if (params_.flee_dist != previous.flee_dist)
+        predator_grid_ = SpatialGrid(params_.width, params_.height, params_.flee_dist);
+
+    if (params_.n != previous.n)
+        resize(params_.n);
+}
+
+// change the number of elements before the last predators entries of v
+// the predators are moved to stay at the end and new elements are default constructed
+template <typename T>
+void resize_before_predators(std::vector<T> &v, std::size_t old_count, std::size_t new_count, std::size_t predators)
+{
+    if (v.empty())
+        return;
+
+    if (new_count > old_count)
+    {
+        v.resize(new_count + predators);
+        std::rotate(v.begin() + old_count, v.begin() + old_count + predators, v.end());
+    }
+    else
+    {
+        std::rotate(v.begin() + new_count, v.begin() + old_count, v.end());
+        v.resize(new_count + predators);
+    }
+}
+
+void Flock::resize(unsigned int n)
+{
+    // allocate everything before changing anything so a failure keeps the old flock
+    try
+    {
+        auto reserve = [&](auto &v)
+        {
+            if (!v.empty())
+                v.reserve(n + predators_);
+        };
+        reserve(positions_);
+        reserve(velocities_);
+        reserve(rotations_);
+        reserve(packed_positions_);
+        reserve(packed_velocities_);
+    }
+    catch (std::bad_alloc &)
+    {
+        std::cerr << "Could not allocate " << n << " boids, keeping " << count_ << '\n';
+        params_.n = count_;
+        return;
+    }
+
+    auto old_count = count_;
+    count_ = n;
+
+    resize_before_predators(positions_, old_count, count_, predators_);
+    resize_before_predators(velocities_, old_count, count_, predators_);
+    resize_before_predators(rotations_, old_count, count_, predators_);
+    resize_before_predators(packed_positions_, old_count, count_, predators_);
+    resize_before_predators(packed_velocities_, old_count, count_, predators_);
+
+    spawn(old_count, count_);
+
+    // reallocate the buffers for the new number of boids
+    // the contents are uploaded at the end of the update
+    auto total = count_ + predators_;
+    glBindBuffer(GL_ARRAY_BUFFER, pos_buffer_);
+    glBufferData(GL_ARRAY_BUFFER, total * (params_.compact ? sizeof(packed_pos) : sizeof(vec2)), nullptr, GL_DYNAMIC_DRAW);
+    glBindBuffer(GL_ARRAY_BUFFER, rotation_buffer_);
+    glBufferData(GL_ARRAY_BUFFER, total * (params_.compact ? sizeof(packed_vel) : sizeof(mat2)), nullptr, GL_DYNAMIC_DRAW);
+    upload_types();
+}
+
+void Flock::spawn(unsigned int first, unsigned int last)
+{
+    // draw the random values in batches keyed on the boid index and tick
+    // so the same boids always start the same way for a seed
+    float r[4 * SPAWN_BATCH];
+    for (unsigned int batch = first; batch < last; batch += SPAWN_BATCH)
+    {
+        auto count = std::min(SPAWN_BATCH, last - batch);
+        rng_.uniform_batch(batch, count, tick_, SPAWN_STREAM, r);
+
+        for (unsigned int j = 0; j < count; ++j)
+        {
+            // random starting position within window
+            vec2 pos;
+            pos[0] = params_.width * r[4 * j];
+            pos[1] = params_.height * r[4 * j + 1];
+
+            // random starting value for velocity
+            // velocity in pixels/sec
+            vec2 vel;
+            vel[0] = MAX_SPEED * (2.f * (r[4 * j + 2] - 0.5f));
+            vel[1] = MAX_SPEED * (2.f * (r[4 * j + 3] - 0.5f));
+
+            if (params_.compact)
+            {
+                set_position<true>(batch + j, pos);
+                set_velocity<true>(batch + j, vel);
+            }
+            else
+            {
+                set_position<false>(batch + j, pos);
+                set_velocity<false>(batch + j, vel);
+            }
+        }
+    }
+}
+
+Flock::~Flock()
+{
+    delete pending_params_.exchange(nullptr);
+}
+
+Flock::Flock(const parameters &params) : 
+    params_(params), count_(params.n), predators_(params.predators),
+    positions_(params.compact ? 0 : count_ + predators_), velocities_(params.compact ? 0 : count_ + predators_),
+    rotations_(params.compact ? 0 : count_ + predators_),
+    packed_positions_(params.compact ? count_ + predators_ : 0), packed_velocities_(params.compact ? count_ + predators_ : 0),
+    pack_origin_(-params.width, -params.height), pack_extent_(3.f * params.width, 3.f * params.height),
+    grid_(params.width, params.height, params.sight_dist),
+    predator_grid_(params.width, params.height, params.flee_dist),
+    rng_(params.seed ? params.seed : std::random_device{}())
+{
     // initialize random positions and velocities
-    for (unsigned int i = 0; i < count_; ++i)
+    // predators are stored after the boids and start the same way
+    spawn(0, count_ + predators_);
+
+    if (params_.processes > 1)
     {
-        // random starting position within window
-        positions_[i][0] = params_.width * rng(generator);
-        positions_[i][1] = params_.height * rng(generator);
+        if (params_.compact || params_.processes > static_cast<int>(MAX_TILES))
+        {
+            std::cerr << "Tile workers need the float representation and at most " << MAX_TILES << " processes\n";
+            exit(1);
+        }
 
-        // random starting value for velocity
-        // velocity in pixels/sec
-        velocities_[i][0] = MAX_SPEED * (2.f * (rng(generator) - 0.5f));
-        velocities_[i][1] = MAX_SPEED * (2.f * (rng(generator) - 0.5f));
+        // forked before the draw data is created, the workers never use the context
+        tiles_ = std::make_unique<SocketTileWorkers>(params_.processes, [this](TileLink &link) { serve_tile(link); });
     }
 
     create_draw_data();
 }
 
-void Flock::wrap(unsigned int i)
+void Flock::wrap(vec2 &pos) const
 {
-    auto &px = positions_[i][0];
-    auto &py = positions_[i][1];
+    auto &px = pos[0];
+    auto &py = pos[1];
 
     if(px < 0)
         px = params_.width;
@@ -212,10 +887,10 @@ void Flock::wrap(unsigned int i)
         py = 0.f;
 }
 
-void Flock::nudge_inside_margin(unsigned int i)
+void Flock::nudge_inside_margin(const vec2 &pos, vec2 &vel) const
 {
-    auto px = positions_[i][0];
-    auto py = positions_[i][1];
+    auto px = pos[0];
+    auto py = pos[1];
 
     vec2 nudge{0, 0};
     if(px < SCREEN_MARGIN)
@@ -228,5 +903,5 @@ void Flock::nudge_inside_margin(unsigned int i)
     else if(py > params_.height - SCREEN_MARGIN)
         nudge[1] = -1;
 
-    velocities_[i] += (nudge.normalize() * SCREEN_NUDGE_WEIGHT).limit(MAX_FORCE);
+    vel += (nudge.normalize() * SCREEN_NUDGE_WEIGHT).limit(MAX_FORCE);
 }
\ No newline at end of file
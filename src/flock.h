@@ -2,9 +2,17 @@
 #define flock_hpp
 
 #include "gl_math.h"
+#include "philox.h"
+#include "spatial_grid.h"
+#include "tiles.h"
+#include <atomic>
+#include <memory>
 #include <vector>
 #include <GL/glew.h>
 
+// most boids supported, a larger flock would not fit in memory on most machines
+constexpr int MAX_BOIDS = 1 << 24;
+
 class Flock
 {
 public:
@@ -20,14 +28,54 @@ public:
         float sight_dist;
         float sight_angle;
         float separation_dist;
+        float wander_factor = 0.f;
+        int predators = 0;
+        float flee_dist = 100.f;
         int height = 800;
         int width = 800;
+        bool compact = false;   // store boids as 16 bit fixed point positions and half float velocities
+        int processes = 1;      // worker processes updating vertical strips of the world, 1 updates every boid in this process
+    };
+
+    /// @brief struct for statistics of a running simulation
+    struct stats
+    {
+        unsigned long long ticks;   // number of updates done
+        unsigned int count;         // number of boids
+        float update_ms;            // time taken by the last update (milliseconds)
     };
 
     /// @brief flock constructor
     /// @param params parameters to be used for the simulation
     Flock(const parameters& params);
 
+    /// @brief flock destructor
+    ~Flock();
+
+    /// @brief queue parameters to be applied at the start of the next update
+    /// safe to call from any thread, replaces queued parameters which have not been applied yet
+    /// width, height, compact, predators and processes are fixed at construction and are ignored
+    /// @param params new parameters for the simulation
+    void set_parameters(const parameters &params);
+
+    /// @brief get statistics of the simulation, safe to call from any thread
+    /// @return the statistics as of the last update
+    stats get_stats() const;
+
+    /// @brief get the position and velocity of every boid, predators last
+    /// must be called from the thread updating the flock
+    /// @param positions set to the positions (pixels)
+    /// @param velocities set to the velocities (pixels/sec)
+    void get_state(std::vector<vec2> &positions, std::vector<vec2> &velocities) const;
+
+    /// @brief get the bytes stored for each boid, read and rewritten by every update
+    /// @return bytes of the position, velocity and rotation of a boid
+    std::size_t state_bytes() const;
+
+    /// @brief get the bytes uploaded to the draw buffers for each boid every update
+    /// @return bytes of the instance data of a boid
+    std::size_t upload_bytes() const;
+
     /// @brief update the positions of the flock based on velocities
     /// @param dt time since last update (seconds)
     void update(float dt);
@@ -35,38 +83,166 @@ public:
     /// @brief draw the boids on the current window at their current positions
     void draw() const;
 
+    /// @brief set the uniforms the shader program needs to draw this flock
+    /// @param shader_program program created for the same storage mode as the flock
+    void set_uniforms(GLuint shader_program) const;
+
 private:
     /// @brief create the draw data to be used in the shaders
     void create_draw_data();
 
+    /// @brief upload the type of every instance, 0 for boids and 1 for predators
+    void upload_types() const;
+
     /// @brief update the draw data with current state of the flock
     void update_draw_data() const;
 
+    /// @brief replace the parameters of the running simulation
+    /// @param params new parameters for the simulation
+    void apply_parameters(const parameters &params);
+
+    /// @brief change the number of boids, new boids are spawned at random
+    /// predators are kept after the boids, the flock is left unchanged if the storage can not be allocated
+    /// @param n new number of boids
+    void resize(unsigned int n);
+
+    /// @brief give boids a random position and velocity
+    /// @param first index of the first boid
+    /// @param last index one past the last boid
+    void spawn(unsigned int first, unsigned int last);
+
     /// @brief wrap the boids across the screen if they are outside
-    /// @param i index of the boid to wrap
-    void wrap(unsigned int i);
+    /// @param pos position of the boid, wrapped in place
+    void wrap(vec2 &pos) const;
     
     /// @brief apply a force to nudge boid back inside screen
-    /// @param i index of boid to nudge
-    void nudge_inside_margin(unsigned int i);
+    /// @param pos position of boid to nudge
+    /// @param vel velocity of boid to nudge
+    void nudge_inside_margin(const vec2 &pos, vec2 &vel) const;
+
+    /// @brief apply the rules kernel matching the current parameters
+    /// @param order callable which is given the function updating a boid and calls it for every boid to update in ascending index order
+    template <typename Order>
+    void run_rules(Order order);
+
+    /// @brief call apply_rules with the runtime flags turned into template arguments
+    /// @param order passed on to apply_rules
+    /// @param flag flag for the next template argument
+    /// @param rest flags for the remaining template arguments
+    template <bool... Policies, typename Order, typename... Flags>
+    void dispatch_rules(Order order, bool flag, Flags... rest);
+
+    /// @brief update velocities of every boid based on flocking rules
+    /// @tparam Wrap wrap boids across the screen instead of nudging them inside the margin
+    /// @tparam FullSight the field of view covers every direction so the angle test is skipped
+    /// @tparam Separation the separation rule has an effect
+    /// @tparam Wander the wander force has an effect
+    /// @tparam Predators there are predators for boids to flee from
+    /// @tparam Compact boids are stored in the compact representation
+    /// @param order callable which is given the function updating a boid and calls it for every boid to update in ascending index order
+    template <bool Wrap, bool FullSight, bool Separation, bool Wander, bool Predators, bool Compact, typename Order>
+    void apply_rules(Order order);
 
     /// @brief update velocity of boid based on flocking rules
     /// @param i index of boid to apply rules to
+    template <bool Wrap, bool FullSight, bool Separation, bool Wander, bool Predators, bool Compact>
     void apply_rules_to_boid(unsigned int i);
+
+    /// @brief update velocities of the predators to chase their closest boid
+    template <bool Wrap, bool Compact>
+    void apply_predator_rules();
+
+    /// @brief send the boids to the tile workers and collect the boids they updated
+    /// replaces the rules step of the update when there are tile workers
+    void update_tiles();
+
+    /// @brief move the edges of the tiles so each tile holds the same number of boids
+    void balance_tiles();
+
+    /// @brief update the boids of a tile every time the coordinator sends them, runs in a tile worker
+    /// @param link connections of the worker
+    void serve_tile(TileLink &link);
+
+    /// @brief move every boid and predator along its velocity
+    /// @param dt time since last update (seconds)
+    template <bool Compact>
+    void apply_velocities(float dt);
     
     /// @brief check if another boid can be seen by the current boid
-    /// @param source boid which is looking
-    /// @param other boid which is tested
+    /// @tparam FullSight the field of view covers every direction so only distance is tested
+    /// @param source position of boid which is looking
+    /// @param other position of boid which is tested
     /// @return true if other boid can be seen
-    bool within_sight(unsigned int source, unsigned int other) const;
+    template <bool FullSight>
+    bool within_sight(const vec2 &source, const vec2 &other) const;
+
+    /// @brief get the position of a boid
+    /// @param i index of the boid
+    /// @return the position (pixels)
+    template <bool Compact>
+    vec2 position(unsigned int i) const;
+
+    /// @brief get the velocity of a boid
+    /// @param i index of the boid
+    /// @return the velocity (pixels/sec)
+    template <bool Compact>
+    vec2 velocity(unsigned int i) const;
+
+    /// @brief store the position of a boid
+    /// @param i index of the boid
+    /// @param pos the position (pixels)
+    template <bool Compact>
+    void set_position(unsigned int i, const vec2 &pos);
+
+    /// @brief store the velocity of a boid
+    /// @param i index of the boid
+    /// @param vel the velocity (pixels/sec)
+    template <bool Compact>
+    void set_velocity(unsigned int i, const vec2 &vel);
 
 private:
-    const parameters params_;
+    /// @brief position as fractions of the quantization bounds in 16 bit fixed point
+    using packed_pos = std::array<GLushort, 2>;
+
+    /// @brief velocity as a pair of half floats
+    using packed_vel = std::array<GLhalf, 2>;
+
+    /// @brief start of the message sent to a tile worker every update
+    /// followed by the owned boids, the halo boids and the predators
+    struct tile_update
+    {
+        parameters params;
+        unsigned long long tick;
+        unsigned int count;
+        unsigned int predators;
+        unsigned int owned;
+        unsigned int halo;
+    };
+
+    parameters params_;
+    std::atomic<const parameters *> pending_params_ = nullptr;
     unsigned int count_;
+    unsigned int predators_;
     std::vector<vec2> positions_;
     std::vector<vec2> velocities_;
     std::vector<mat2> rotations_;
-    GLuint pos_buffer_, rotation_buffer_;
+    std::vector<packed_pos> packed_positions_;
+    std::vector<packed_vel> packed_velocities_;
+    vec2 pack_origin_, pack_extent_;
+    SpatialGrid grid_;
+    std::vector<unsigned int> neighbors_;
+    SpatialGrid predator_grid_;
+    std::vector<unsigned int> threats_;
+    GLuint pos_buffer_, rotation_buffer_, type_buffer_;
+    Philox rng_;
+    unsigned long long tick_ = 0;
+    std::atomic<unsigned long long> ticks_ = 0;
+    std::atomic<unsigned int> stats_count_ = 0;
+    std::atomic<float> update_ms_ = 0.f;
+    std::unique_ptr<TileWorkers> tiles_;   // transport to the tile workers, null when every boid is updated here
+    std::vector<float> tile_bounds_;   // x coordinate where each tile after the first starts
+    std::vector<std::vector<tile_boid>> tile_owned_, tile_halo_;
+    std::vector<tile_boid> tile_predators_;
 };
 
 #endif
\ No newline at end of file
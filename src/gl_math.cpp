@@ -1,6 +1,8 @@
 #define _USE_MATH_DEFINES
 #include "gl_math.h"
 #include <cmath>
+#include <cstdint>
+#include <cstring>
 
 mat4 make_ortho(const float left, const float right, const float bottom, const float top)
 {
@@ -44,6 +46,64 @@ mat2 rotation_matrix(const float theta)
     return m;
 }
 
+GLhalf to_half(const float value)
+{
+    uint32_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+
+    uint32_t sign = (bits >> 16) & 0x8000;
+    int32_t exponent = static_cast<int32_t>((bits >> 23) & 0xff) - 127 + 15;
+    uint32_t mantissa = bits & 0x7fffff;
+
+    // infinity and nan
+    if (((bits >> 23) & 0xff) == 0xff)
+        return sign | 0x7c00 | (mantissa ? 0x200 : 0);
+    // too large for a half float
+    if (exponent >= 31)
+        return sign | 0x7c00;
+    // subnormal half float or zero
+    if (exponent <= 0)
+    {
+        if (exponent < -10)
+            return sign;
+        mantissa |= 0x800000;
+        int shift = 14 - exponent;
+        uint32_t half = mantissa >> shift;
+        if ((mantissa >> (shift - 1)) & 1)
+            ++half;
+        return sign | half;
+    }
+
+    // rounding up may carry into the exponent which is still the correct result
+    uint32_t half = (exponent << 10) | (mantissa >> 13);
+    if (mantissa & 0x1000)
+        ++half;
+    return sign | half;
+}
+
+float from_half(const GLhalf bits)
+{
+    uint32_t sign = static_cast<uint32_t>(bits & 0x8000) << 16;
+    uint32_t exponent = (bits >> 10) & 0x1f;
+    uint32_t mantissa = bits & 0x3ff;
+
+    uint32_t out;
+    if (exponent == 0)
+    {
+        // subnormal half float or zero
+        float value = std::ldexp(static_cast<float>(mantissa), -24);
+        return sign ? -value : value;
+    }
+    else if (exponent == 31)
+        out = sign | 0x7f800000 | (mantissa << 13);
+    else
+        out = sign | ((exponent - 15 + 127) << 23) | (mantissa << 13);
+
+    float value;
+    std::memcpy(&value, &out, sizeof(value));
+    return value;
+}
+
 vec2::vec2() : data_()
 {
     data_[0] = 0.f;
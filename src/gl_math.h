@@ -23,6 +23,16 @@ mat4 make_ortho(const float left, const float right, const float bottom, const f
 /// @return the rotation matrix
 mat2 rotation_matrix(const float theta);
 
+/// @brief convert a float to a half float, rounding to nearest with ties away from zero
+/// @param value the value to convert
+/// @return the bits of the half float
+GLhalf to_half(const float value);
+
+/// @brief convert a half float to a float
+/// @param bits the bits of the half float
+/// @return the value as a float
+float from_half(const GLhalf bits);
+
 /// @brief lightweight 2 element vector class
 class vec2
 {
@@ -43,6 +53,11 @@ class vec2
         /// @param other vec2 to copy
         vec2(const vec2 &other);
 
+        /// @brief copy assignment
+        /// @param other vec2 to copy
+        /// @return this vector
+        vec2 &operator=(const vec2 &other) = default;
+
         GLfloat operator[](int i) const;
         GLfloat& operator[](int i);
 
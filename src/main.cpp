@@ -4,10 +4,16 @@
 #include "flock.h"
 #include "gl_math.h"
 #include "utils.h"
+#include "recorder.h"
+#include "control.h"
+#include <memory>
 
 int main(int argc, char* argv[])
 {
-    Flock::parameters params = handle_arguments(argc, argv);
+    FrameRecorder::options record;
+    std::string control_path;
+    Flock::parameters params = handle_arguments(argc, argv, record, control_path);
+    bool offscreen = !record.output.empty();
 
     GLFWwindow *window;
 
@@ -20,7 +26,9 @@ int main(int argc, char* argv[])
     glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
 
     // create window
+    // when recording the window is only needed for its context and stays hidden
     glfwWindowHint(GLFW_RESIZABLE, GLFW_FALSE);
+    glfwWindowHint(GLFW_VISIBLE, offscreen ? GLFW_FALSE : GLFW_TRUE);
     window = glfwCreateWindow(params.width, params.height, "Flocking Simulation", NULL, NULL);
     if (!window)
     {
@@ -30,7 +38,7 @@ int main(int argc, char* argv[])
 
     // Make the window's context current
     glfwMakeContextCurrent(window);
-    glfwSwapInterval(1);
+    glfwSwapInterval(offscreen ? 0 : 1);
 
     // required for lab computers
     glewExperimental = GL_TRUE;
@@ -40,7 +48,7 @@ int main(int argc, char* argv[])
     }
 
     // create and use shaders
-    GLuint shader_program = create_shader_program();
+    GLuint shader_program = create_shader_program(params.compact);
     glUseProgram(shader_program);
 
     // project to pixel space
@@ -50,20 +58,46 @@ int main(int argc, char* argv[])
 
     FrameLimiter limiter(60);
     Flock flock(params);
+    flock.set_uniforms(shader_program);
 
-    // Loop until the user closes the window
-    while (!glfwWindowShouldClose(window))
-    {
-        glClear(GL_COLOR_BUFFER_BIT);
+    // parameters sent to the control socket are applied by the flock between updates
+    std::unique_ptr<ControlServer> control;
+    if (!control_path.empty())
+        control = std::make_unique<ControlServer>(flock, params, control_path);
 
-        if(limiter.should_update())
+    if (offscreen)
+    {
+        // render every tick as fast as possible instead of at the frame limit
+        // the recorder flushes its frames when it goes out of scope, before the context is destroyed
+        FrameRecorder recorder(params.width, params.height, record);
+        while (!recorder.done() && !glfwWindowShouldClose(window))
         {
+            recorder.begin_frame();
+            glClear(GL_COLOR_BUFFER_BIT);
+
             flock.update(limiter.frame_dt());
+            flock.draw();
+
+            recorder.end_frame();
+            glfwPollEvents();
         }
-        flock.draw();
+    }
+    else
+    {
+        // Loop until the user closes the window
+        while (!glfwWindowShouldClose(window))
+        {
+            glClear(GL_COLOR_BUFFER_BIT);
 
-        glfwSwapBuffers(window); // swap front and back buffers
-        glfwPollEvents();        // poll and process events
+            if(limiter.should_update())
+            {
+                flock.update(limiter.frame_dt());
+            }
+            flock.draw();
+
+            glfwSwapBuffers(window); // swap front and back buffers
+            glfwPollEvents();        // poll and process events
+        }
     }
 
     glDeleteProgram(shader_program);
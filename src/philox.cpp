@@ -0,0 +1,101 @@
+#include "philox.h"
+
+// constants of the Philox4x32 rounds and key schedule
+constexpr std::uint32_t PHILOX_M0 = 0xD2511F53;
+constexpr std::uint32_t PHILOX_M1 = 0xCD9E8D57;
+constexpr std::uint32_t PHILOX_W0 = 0x9E3779B9;
+constexpr std::uint32_t PHILOX_W1 = 0xBB67AE85;
+constexpr int PHILOX_ROUNDS = 10;
+
+// number of ids generated together by uniform_batch
+constexpr std::uint32_t BATCH_LANES = 8;
+
+Philox::Philox(std::uint64_t seed) :
+    key_{static_cast<std::uint32_t>(seed), static_cast<std::uint32_t>(seed >> 32)}
+{
+}
+
+Philox::block Philox::operator()(const block &counter) const
+{
+    auto c = counter;
+    auto k = key_;
+
+    for (int round = 0; round < PHILOX_ROUNDS; ++round)
+    {
+        std::uint64_t p0 = static_cast<std::uint64_t>(PHILOX_M0) * c[0];
+        std::uint64_t p1 = static_cast<std::uint64_t>(PHILOX_M1) * c[2];
+        c = {
+            static_cast<std::uint32_t>(p1 >> 32) ^ c[1] ^ k[0],
+            static_cast<std::uint32_t>(p1),
+            static_cast<std::uint32_t>(p0 >> 32) ^ c[3] ^ k[1],
+            static_cast<std::uint32_t>(p0)};
+        k[0] += PHILOX_W0;
+        k[1] += PHILOX_W1;
+    }
+
+    return c;
+}
+
+void Philox::uniform_batch(std::uint32_t first, std::uint32_t count, std::uint64_t tick, std::uint32_t stream, float *out) const
+{
+    std::uint32_t done = 0;
+
+    // full lanes, each round is the same operation on every lane so the compiler can use simd
+    for (; done + BATCH_LANES <= count; done += BATCH_LANES)
+    {
+        std::uint32_t c0[BATCH_LANES], c1[BATCH_LANES], c2[BATCH_LANES], c3[BATCH_LANES];
+        for (std::uint32_t l = 0; l < BATCH_LANES; ++l)
+        {
+            c0[l] = first + done + l;
+            c1[l] = static_cast<std::uint32_t>(tick);
+            c2[l] = stream;
+            c3[l] = static_cast<std::uint32_t>(tick >> 32);
+        }
+
+        auto k = key_;
+        for (int round = 0; round < PHILOX_ROUNDS; ++round)
+        {
+            for (std::uint32_t l = 0; l < BATCH_LANES; ++l)
+            {
+                std::uint64_t p0 = static_cast<std::uint64_t>(PHILOX_M0) * c0[l];
+                std::uint64_t p1 = static_cast<std::uint64_t>(PHILOX_M1) * c2[l];
+                std::uint32_t n0 = static_cast<std::uint32_t>(p1 >> 32) ^ c1[l] ^ k[0];
+                std::uint32_t n2 = static_cast<std::uint32_t>(p0 >> 32) ^ c3[l] ^ k[1];
+                c1[l] = static_cast<std::uint32_t>(p1);
+                c3[l] = static_cast<std::uint32_t>(p0);
+                c0[l] = n0;
+                c2[l] = n2;
+            }
+            k[0] += PHILOX_W0;
+            k[1] += PHILOX_W1;
+        }
+
+        for (std::uint32_t l = 0; l < BATCH_LANES; ++l)
+        {
+            auto o = out + 4 * (done + l);
+            o[0] = to_unit(c0[l]);
+            o[1] = to_unit(c1[l]);
+            o[2] = to_unit(c2[l]);
+            o[3] = to_unit(c3[l]);
+        }
+    }
+
+    // remaining ids which do not fill a lane
+    for (; done < count; ++done)
+    {
+        auto r = (*this)(counter(first + done, tick, stream));
+        for (int j = 0; j < 4; ++j)
+            out[4 * done + j] = to_unit(r[j]);
+    }
+}
+
+Philox::block Philox::counter(std::uint32_t id, std::uint64_t tick, std::uint32_t stream)
+{
+    return {id, static_cast<std::uint32_t>(tick), stream, static_cast<std::uint32_t>(tick >> 32)};
+}
+
+float Philox::to_unit(std::uint32_t bits)
+{
+    // top 24 bits fill the mantissa exactly so the result is never rounded up to 1
+    return (bits >> 8) * (1.f / 16777216.f);
+}
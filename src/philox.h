@@ -0,0 +1,51 @@
+#ifndef philox_hpp
+#define philox_hpp
+
+#include <array>
+#include <cstdint>
+
+/// @brief counter based random number generator (Philox4x32-10)
+///
+/// every output is a pure function of the seed and a counter so boids can draw
+/// numbers keyed on their id and the current tick in any order and get the same values
+class Philox
+{
+public:
+    /// @brief 128 bit counter or output block
+    using block = std::array<std::uint32_t, 4>;
+
+    /// @brief Philox constructor
+    /// @param seed seed used as the key of the generator
+    Philox(std::uint64_t seed);
+
+    /// @brief generate the random block for a counter
+    /// @param counter counter to generate for
+    /// @return 4 random 32 bit values
+    block operator()(const block &counter) const;
+
+    /// @brief generate 4 uniform floats for each id in a range
+    /// ids are processed in lanes so the rounds vectorize
+    /// @param first first id of the range
+    /// @param count number of ids in the range
+    /// @param tick tick the numbers are drawn for
+    /// @param stream purpose the numbers are drawn for, keeps separate uses independent
+    /// @param out filled with 4 * count floats in [0, 1), 4 consecutive floats per id
+    void uniform_batch(std::uint32_t first, std::uint32_t count, std::uint64_t tick, std::uint32_t stream, float *out) const;
+
+    /// @brief make the counter for an id at a tick
+    /// @param id id of the boid drawing the numbers
+    /// @param tick tick the numbers are drawn for
+    /// @param stream purpose the numbers are drawn for
+    /// @return the counter
+    static block counter(std::uint32_t id, std::uint64_t tick, std::uint32_t stream);
+
+    /// @brief convert a random 32 bit value to a float
+    /// @param bits random value
+    /// @return a uniform float in [0, 1)
+    static float to_unit(std::uint32_t bits);
+
+private:
+    std::array<std::uint32_t, 2> key_;
+};
+
+#endif
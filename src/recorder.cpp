@@ -0,0 +1,233 @@
+#include "recorder.h"
+#include <cstring>
+#include <iostream>
+
+FrameRecorder::FrameRecorder(int width, int height, const options &opts) :
+    width_(width), height_(height), opts_(opts)
+{
+    if (opts_.format != "ppm" && opts_.format != "y4m")
+    {
+        std::cerr << "Unknown recording format: " << opts_.format << '\n';
+        exit(1);
+    }
+
+    if (opts_.format == "y4m")
+    {
+        // a single stream, "-" writes to stdout so it can be piped into an encoder
+        stream_ = opts_.output == "-" ? stdout : std::fopen(opts_.output.c_str(), "wb");
+        if (!stream_)
+        {
+            std::cerr << "Could not open " << opts_.output << " for writing\n";
+            exit(1);
+        }
+        // frames are always stepped with a 1/60 second dt
+        std::fprintf(stream_, "YUV4MPEG2 W%d H%d F60:1 Ip A1:1 C444\n", width_, height_);
+        planes_.resize(3 * width_ * height_);
+    }
+    else
+    {
+        // the frames are written on the encoder thread, check the first one can be created
+        // so a missing directory stops the run here instead of dropping every frame
+        auto path = frame_path(0);
+        auto file = std::fopen(path.c_str(), "wb");
+        if (!file)
+        {
+            std::cerr << "Could not open " << path << " for writing\n";
+            exit(1);
+        }
+        std::fclose(file);
+    }
+
+    // framebuffer with a single color attachment to render the flock into
+    glGenFramebuffers(1, &fbo_);
+    glBindFramebuffer(GL_FRAMEBUFFER, fbo_);
+    glGenRenderbuffers(1, &color_rb_);
+    glBindRenderbuffer(GL_RENDERBUFFER, color_rb_);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width_, height_);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, color_rb_);
+
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+    {
+        std::cerr << "Error creating offscreen framebuffer\n";
+        exit(1);
+    }
+
+    // pixel buffers let glReadPixels return immediately
+    // the copy is only waited on once the buffer comes around again
+    glGenBuffers(NUM_PBOS, pbos_.data());
+    for (auto pbo : pbos_)
+    {
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, pbo);
+        glBufferData(GL_PIXEL_PACK_BUFFER, 4 * width_ * height_, nullptr, GL_STREAM_READ);
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+    encoder_ = std::thread(&FrameRecorder::encode_loop, this);
+}
+
+FrameRecorder::~FrameRecorder()
+{
+    // collect the read backs still in flight
+    while (collected_ < submitted_)
+        collect(collected_ % NUM_PBOS);
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        finished_ = true;
+    }
+    cv_.notify_all();
+    encoder_.join();
+
+    if (stream_ && stream_ != stdout)
+        std::fclose(stream_);
+    else if (stream_)
+        std::fflush(stream_);
+
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glDeleteBuffers(NUM_PBOS, pbos_.data());
+    glDeleteRenderbuffers(1, &color_rb_);
+    glDeleteFramebuffers(1, &fbo_);
+}
+
+void FrameRecorder::begin_frame() const
+{
+    glBindFramebuffer(GL_FRAMEBUFFER, fbo_);
+    glViewport(0, 0, width_, height_);
+}
+
+void FrameRecorder::end_frame()
+{
+    // oldest read back must be collected before its buffer is reused
+    if (submitted_ - collected_ == NUM_PBOS)
+        collect(collected_ % NUM_PBOS);
+
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, fbo_);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, pbos_[submitted_ % NUM_PBOS]);
+    glReadPixels(0, 0, width_, height_, GL_RGBA, GL_UNSIGNED_BYTE, 0);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    ++submitted_;
+}
+
+bool FrameRecorder::done() const
+{
+    return submitted_ >= opts_.frames;
+}
+
+void FrameRecorder::collect(unsigned int pbo)
+{
+    std::vector<unsigned char> frame;
+    {
+        // wait for the encoder if it has fallen too far behind
+        std::unique_lock<std::mutex> lock(mutex_);
+        cv_.wait(lock, [this] { return queue_.size() < MAX_QUEUED; });
+        if (!free_frames_.empty())
+        {
+            frame = std::move(free_frames_.back());
+            free_frames_.pop_back();
+        }
+    }
+    frame.resize(4 * width_ * height_);
+
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, pbos_[pbo]);
+    auto pixels = glMapBuffer(GL_PIXEL_PACK_BUFFER, GL_READ_ONLY);
+    if (pixels)
+    {
+        std::memcpy(frame.data(), pixels, frame.size());
+        glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    ++collected_;
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        queue_.push_back(std::move(frame));
+    }
+    cv_.notify_all();
+}
+
+void FrameRecorder::encode_loop()
+{
+    unsigned int index = 0;
+    while (true)
+    {
+        std::vector<unsigned char> frame;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            cv_.wait(lock, [this] { return finished_ || !queue_.empty(); });
+            if (queue_.empty())
+                return;
+            frame = std::move(queue_.front());
+            queue_.pop_front();
+        }
+        cv_.notify_all();
+
+        if (stream_)
+            write_y4m(frame);
+        else
+            write_ppm(frame, index);
+        ++index;
+
+        // hand the buffer back so the render thread does not need to allocate
+        std::lock_guard<std::mutex> lock(mutex_);
+        free_frames_.push_back(std::move(frame));
+    }
+}
+
+std::string FrameRecorder::frame_path(unsigned int index) const
+{
+    char name[32];
+    std::snprintf(name, sizeof(name), "_%06u.ppm", index);
+    return opts_.output + name;
+}
+
+void FrameRecorder::write_ppm(const std::vector<unsigned char> &frame, unsigned int index) const
+{
+    auto path = frame_path(index);
+    auto file = std::fopen(path.c_str(), "wb");
+    if (!file)
+    {
+        std::cerr << "Could not open " << path << " for writing\n";
+        return;
+    }
+
+    std::fprintf(file, "P6\n%d %d\n255\n", width_, height_);
+    std::vector<unsigned char> row(3 * width_);
+    // opengl rows start at the bottom, images start at the top
+    for (int y = height_ - 1; y >= 0; --y)
+    {
+        auto src = &frame[4 * y * width_];
+        for (int x = 0; x < width_; ++x)
+        {
+            row[3 * x] = src[4 * x];
+            row[3 * x + 1] = src[4 * x + 1];
+            row[3 * x + 2] = src[4 * x + 2];
+        }
+        std::fwrite(row.data(), 1, row.size(), file);
+    }
+    std::fclose(file);
+}
+
+void FrameRecorder::write_y4m(const std::vector<unsigned char> &frame)
+{
+    auto plane = width_ * height_;
+    auto Y = planes_.data();
+    auto U = Y + plane;
+    auto V = U + plane;
+
+    // convert to limited range BT.601 with full resolution chroma
+    for (int y = 0; y < height_; ++y)
+    {
+        auto src = &frame[4 * (height_ - 1 - y) * width_];
+        for (int x = 0; x < width_; ++x)
+        {
+            int r = src[4 * x], g = src[4 * x + 1], b = src[4 * x + 2];
+            auto out = y * width_ + x;
+            Y[out] = static_cast<unsigned char>(16 + ((66 * r + 129 * g + 25 * b + 128) >> 8));
+            U[out] = static_cast<unsigned char>(128 + ((-38 * r - 74 * g + 112 * b + 128) >> 8));
+            V[out] = static_cast<unsigned char>(128 + ((112 * r - 94 * g - 18 * b + 128) >> 8));
+        }
+    }
+
+    std::fputs("FRAME\n", stream_);
+    std::fwrite(planes_.data(), 1, planes_.size(), stream_);
+}
@@ -0,0 +1,93 @@
+#ifndef recorder_hpp
+#define recorder_hpp
+
+#include <GL/glew.h>
+#include <array>
+#include <condition_variable>
+#include <cstdio>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/// @brief renders frames into an offscreen framebuffer and encodes them on a background thread
+class FrameRecorder
+{
+public:
+    /// @brief struct for options of an offscreen recording
+    struct options
+    {
+        std::string output;           // output path, recording is disabled if empty
+        std::string format = "ppm";   // "ppm" for an image sequence or "y4m" for a video stream
+        unsigned int frames = 600;    // number of frames to record
+    };
+
+    /// @brief FrameRecorder constructor
+    /// @param width width of the frames (pixels)
+    /// @param height height of the frames (pixels)
+    /// @param opts options for the recording
+    FrameRecorder(int width, int height, const options &opts);
+
+    /// @brief flushes all pending frames and stops the encoder
+    ~FrameRecorder();
+
+    FrameRecorder(const FrameRecorder &) = delete;
+    FrameRecorder &operator=(const FrameRecorder &) = delete;
+
+    /// @brief bind the offscreen framebuffer so the next draws are recorded
+    void begin_frame() const;
+
+    /// @brief start an asynchronous read back of the current frame
+    /// and hand the oldest completed frame to the encoder
+    void end_frame();
+
+    /// @brief check if all requested frames have been recorded
+    /// @return true if the recording is complete
+    bool done() const;
+
+private:
+    /// @brief copy a finished pixel buffer into a frame for the encoder
+    /// @param pbo index of the pixel buffer to copy
+    void collect(unsigned int pbo);
+
+    /// @brief encoder thread loop writing queued frames to the output
+    void encode_loop();
+
+    /// @brief get the path of an image of the sequence
+    /// @param index index of the frame in the recording
+    /// @return output path followed by the zero padded index
+    std::string frame_path(unsigned int index) const;
+
+    /// @brief write a frame as a binary ppm image
+    /// @param frame rgba pixels of the frame, bottom row first
+    /// @param index index of the frame in the recording
+    void write_ppm(const std::vector<unsigned char> &frame, unsigned int index) const;
+
+    /// @brief write a frame to the y4m stream
+    /// @param frame rgba pixels of the frame, bottom row first
+    void write_y4m(const std::vector<unsigned char> &frame);
+
+private:
+    static constexpr unsigned int NUM_PBOS = 3;     // read backs in flight before the first one is mapped
+    static constexpr unsigned int MAX_QUEUED = 8;   // frames waiting for the encoder before rendering blocks
+
+    int width_, height_;
+    options opts_;
+    GLuint fbo_, color_rb_;
+    std::array<GLuint, NUM_PBOS> pbos_;
+    unsigned int submitted_ = 0;
+    unsigned int collected_ = 0;
+
+    std::FILE *stream_ = nullptr;
+    std::vector<unsigned char> planes_;
+
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    std::deque<std::vector<unsigned char>> queue_;
+    std::vector<std::vector<unsigned char>> free_frames_;
+    bool finished_ = false;
+    std::thread encoder_;
+};
+
+#endif
@@ -11,13 +11,43 @@ inline const char *vertex_source =
         layout(location=0) in vec2 position;
         layout(location=1) in vec2 translate;
         layout(location=2) in mat2 rotation;
+        layout(location=4) in float type;
 
         uniform mat4 u_proj;
 
+        out float v_type;
 
         void main()
         {
-        gl_Position = u_proj * vec4((rotation * position) + translate, 0, 1);
+        // predators are drawn twice as large as boids
+        v_type = type;
+        gl_Position = u_proj * vec4((rotation * position * (1.0 + type)) + translate, 0, 1);
+        }
+    )";
+
+// compact boids have normalized short positions and half float velocities
+// the rotation is built from the direction of the velocity
+inline const char *compact_vertex_source =
+    R"(
+        #version 450
+        layout(location=0) in vec2 position;
+        layout(location=1) in vec2 packed_translate;
+        layout(location=2) in vec2 velocity;
+        layout(location=4) in float type;
+
+        uniform mat4 u_proj;
+        uniform vec2 u_pack_origin;
+        uniform vec2 u_pack_extent;
+
+        out float v_type;
+
+        void main()
+        {
+        vec2 dir = normalize(velocity);
+        mat2 rotation = mat2(dir.x, dir.y, -dir.y, dir.x);
+        vec2 translate = u_pack_origin + packed_translate * u_pack_extent;
+        v_type = type;
+        gl_Position = u_proj * vec4((rotation * position * (1.0 + type)) + translate, 0, 1);
         }
     )";
 
@@ -26,9 +56,12 @@ inline const char *fragment_source =
         #version 330 core
         layout(location=0) out vec4 color;
 
+        in float v_type;
+
         void main()
         {
-            color = vec4(0.5, 1.0, 0.8, 0.8);
+            // boids and predators are told apart by color
+            color = mix(vec4(0.5, 1.0, 0.8, 0.8), vec4(1.0, 0.35, 0.3, 1.0), v_type);
         }
     )";
 
@@ -51,13 +84,13 @@ GLuint compile_shader(GLuint type, const char* source_code)
     return shaderID;
 }
 
-GLuint create_shader_program()
+GLuint create_shader_program(bool compact)
 {
     // need a program to attach the shaders to
     GLuint programID = glCreateProgram();
 
     // compile the shaders from files
-    GLuint vertex_shaderID = compile_shader(GL_VERTEX_SHADER, vertex_source);
+    GLuint vertex_shaderID = compile_shader(GL_VERTEX_SHADER, compact ? compact_vertex_source : vertex_source);
     GLuint fragment_shaderID = compile_shader(GL_FRAGMENT_SHADER, fragment_source);
 
     // attach the shaders to the program
@@ -10,7 +10,8 @@
 GLuint compile_shader(GLuint type, const char *source_code);
 
 /// @brief create shader program with vertex and fragment shader
+/// @param compact create the vertex shader for a flock in the compact representation
 /// @return the id of the created program
-GLuint create_shader_program();
+GLuint create_shader_program(bool compact = false);
 
 #endif
\ No newline at end of file
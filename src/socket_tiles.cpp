@@ -0,0 +1,314 @@
+#include "socket_tiles.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+// bytes read from a worker socket at once
+constexpr std::size_t RECEIVE_CHUNK = 64 * 1024;
+
+// write all of a buffer to a blocking socket
+// returns false if the other end went away
+static bool send_all(int socket, const void *data, std::size_t size)
+{
+    auto bytes = static_cast<const char *>(data);
+    while (size > 0)
+    {
+        auto sent = ::send(socket, bytes, size, MSG_NOSIGNAL);
+        if (sent < 0 && errno == EINTR)
+            continue;
+        if (sent <= 0)
+            return false;
+        bytes += sent;
+        size -= sent;
+    }
+    return true;
+}
+
+// read all of a buffer from a blocking socket
+// returns the number of bytes read, less than size if the other end went away
+static std::size_t receive_all(int socket, void *data, std::size_t size)
+{
+    auto bytes = static_cast<char *>(data);
+    std::size_t done = 0;
+    while (done < size)
+    {
+        auto received = ::recv(socket, bytes + done, size - done, 0);
+        if (received < 0 && errno == EINTR)
+            continue;
+        if (received <= 0)
+            break;
+        done += received;
+    }
+    return done;
+}
+
+// a worker can not recover from a broken connection
+// _exit skips the exit handlers, they belong to the coordinator and its window
+[[noreturn]] static void worker_failed(unsigned int tile, const char *what)
+{
+    std::cerr << "Tile worker " << tile << ": " << what << '\n';
+    _exit(1);
+}
+
+SocketTileLink::SocketTileLink(unsigned int tile, int coordinator, std::vector<int> peers) :
+    tile_(tile), coordinator_(coordinator), peers_(std::move(peers)),
+    outgoing_(peers_.size()), sent_(peers_.size(), 0), incoming_(peers_.size()), taken_(peers_.size(), 0)
+{
+    // the workers never block on each other, a full socket is retried while waiting for data instead
+    for (auto peer : peers_)
+    {
+        if (peer >= 0)
+            ::fcntl(peer, F_SETFL, ::fcntl(peer, F_GETFL) | O_NONBLOCK);
+    }
+}
+
+SocketTileLink::~SocketTileLink()
+{
+    ::close(coordinator_);
+    for (auto peer : peers_)
+    {
+        if (peer >= 0)
+            ::close(peer);
+    }
+}
+
+unsigned int SocketTileLink::tile() const
+{
+    return tile_;
+}
+
+bool SocketTileLink::read(void *data, std::size_t size)
+{
+    auto received = receive_all(coordinator_, data, size);
+    if (size > 0 && received == 0)
+        return false;
+    if (received < size)
+        worker_failed(tile_, "connection to the coordinator closed mid message");
+    return true;
+}
+
+void SocketTileLink::write(const void *data, std::size_t size)
+{
+    if (!send_all(coordinator_, data, size))
+        worker_failed(tile_, "connection to the coordinator closed");
+}
+
+void SocketTileLink::post(unsigned int peer, const tile_boid &boid)
+{
+    // only queued, the queues are written once this worker would block
+    // so a run of boids costs one send instead of one each
+    auto bytes = reinterpret_cast<const char *>(&boid);
+    outgoing_[peer].insert(outgoing_[peer].end(), bytes, bytes + sizeof(boid));
+}
+
+void SocketTileLink::next(unsigned int peer, tile_boid &boid)
+{
+    if (incoming_[peer].size() - taken_[peer] < sizeof(boid))
+    {
+        // the other worker may be waiting on boids queued here before it can send this one
+        send_all_queued();
+        while (incoming_[peer].size() - taken_[peer] < sizeof(boid))
+            pump();
+    }
+
+    std::memcpy(&boid, incoming_[peer].data() + taken_[peer], sizeof(boid));
+    taken_[peer] += sizeof(boid);
+
+    // start over once everything received has been taken
+    if (taken_[peer] == incoming_[peer].size())
+    {
+        incoming_[peer].clear();
+        taken_[peer] = 0;
+    }
+}
+
+void SocketTileLink::flush()
+{
+    send_all_queued();
+    for (unsigned int peer = 0; peer < peers_.size(); ++peer)
+    {
+        while (sent_[peer] < outgoing_[peer].size())
+            pump();
+    }
+}
+
+void SocketTileLink::send_all_queued()
+{
+    for (unsigned int peer = 0; peer < peers_.size(); ++peer)
+    {
+        if (sent_[peer] < outgoing_[peer].size())
+            send_queued(peer);
+    }
+}
+
+void SocketTileLink::send_queued(unsigned int peer)
+{
+    auto &queue = outgoing_[peer];
+    while (sent_[peer] < queue.size())
+    {
+        auto sent = ::send(peers_[peer], queue.data() + sent_[peer], queue.size() - sent_[peer], MSG_NOSIGNAL | MSG_DONTWAIT);
+        if (sent < 0 && errno == EINTR)
+            continue;
+        if (sent < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+            return;
+        if (sent <= 0)
+            worker_failed(tile_, "connection to another worker closed");
+        sent_[peer] += sent;
+    }
+
+    queue.clear();
+    sent_[peer] = 0;
+}
+
+void SocketTileLink::pump()
+{
+    // wait for data from any worker while writing to any worker which can take more
+    // reading everything keeps the other workers from blocking on a full socket
+    fds_.clear();
+    fd_tiles_.clear();
+    for (unsigned int peer = 0; peer < peers_.size(); ++peer)
+    {
+        if (peers_[peer] < 0)
+            continue;
+        short events = POLLIN;
+        if (sent_[peer] < outgoing_[peer].size())
+            events |= POLLOUT;
+        fds_.push_back({peers_[peer], events, 0});
+        fd_tiles_.push_back(peer);
+    }
+
+    if (::poll(fds_.data(), fds_.size(), -1) < 0)
+    {
+        if (errno == EINTR)
+            return;
+        worker_failed(tile_, std::strerror(errno));
+    }
+
+    for (std::size_t f = 0; f < fds_.size(); ++f)
+    {
+        auto peer = fd_tiles_[f];
+        if (fds_[f].revents & POLLOUT)
+            send_queued(peer);
+
+        if (fds_[f].revents & (POLLIN | POLLHUP | POLLERR))
+        {
+            auto &buffer = incoming_[peer];
+            auto old_size = buffer.size();
+            buffer.resize(old_size + RECEIVE_CHUNK);
+            auto received = ::recv(peers_[peer], buffer.data() + old_size, RECEIVE_CHUNK, MSG_DONTWAIT);
+            buffer.resize(old_size + std::max<ssize_t>(received, 0));
+
+            if (received == 0 || (received < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR))
+                worker_failed(tile_, "connection to another worker closed");
+        }
+    }
+}
+
+SocketTileWorkers::SocketTileWorkers(unsigned int tiles, const serve_fn &serve)
+{
+    // one connection from the coordinator to each worker
+    // and one between every pair of workers for the boids in their halos
+    std::vector<int> coordinator_ends(tiles), worker_ends(tiles);
+    std::vector<std::vector<int>> peers(tiles, std::vector<int>(tiles, -1));
+    auto connect = [](int &a, int &b)
+    {
+        int ends[2];
+        if (::socketpair(AF_UNIX, SOCK_STREAM, 0, ends) < 0)
+        {
+            std::cerr << "Could not create tile worker sockets: " << std::strerror(errno) << '\n';
+            exit(1);
+        }
+        a = ends[0];
+        b = ends[1];
+    };
+
+    for (unsigned int t = 0; t < tiles; ++t)
+    {
+        connect(coordinator_ends[t], worker_ends[t]);
+        for (unsigned int other = 0; other < t; ++other)
+            connect(peers[t][other], peers[other][t]);
+    }
+
+    auto close_all = [](const std::vector<int> &sockets, int keep)
+    {
+        for (auto s : sockets)
+        {
+            if (s >= 0 && s != keep)
+                ::close(s);
+        }
+    };
+
+    for (unsigned int t = 0; t < tiles; ++t)
+    {
+        auto pid = ::fork();
+        if (pid < 0)
+        {
+            std::cerr << "Could not start tile worker: " << std::strerror(errno) << '\n';
+            exit(1);
+        }
+
+        if (pid == 0)
+        {
+            // the worker keeps only its own sockets
+            // so every connection closes as soon as the process at either end is gone
+            close_all(coordinator_ends, -1);
+            close_all(worker_ends, worker_ends[t]);
+            for (unsigned int other = 0; other < tiles; ++other)
+            {
+                if (other != t)
+                    close_all(peers[other], -1);
+            }
+
+            {
+                SocketTileLink link(t, worker_ends[t], peers[t]);
+                serve(link);
+            }
+            _exit(0);
+        }
+
+        pids_.push_back(pid);
+    }
+
+    close_all(worker_ends, -1);
+    for (auto &p : peers)
+        close_all(p, -1);
+    sockets_ = coordinator_ends;
+}
+
+SocketTileWorkers::~SocketTileWorkers()
+{
+    // the workers exit once their connection is closed
+    for (auto s : sockets_)
+        ::close(s);
+    for (auto pid : pids_)
+        ::waitpid(pid, nullptr, 0);
+}
+
+unsigned int SocketTileWorkers::size() const
+{
+    return sockets_.size();
+}
+
+void SocketTileWorkers::write(unsigned int tile, const void *data, std::size_t size)
+{
+    if (!send_all(sockets_[tile], data, size))
+    {
+        std::cerr << "Tile worker " << tile << " stopped\n";
+        exit(1);
+    }
+}
+
+void SocketTileWorkers::read(unsigned int tile, void *data, std::size_t size)
+{
+    if (receive_all(sockets_[tile], data, size) < size)
+    {
+        std::cerr << "Tile worker " << tile << " stopped\n";
+        exit(1);
+    }
+}
@@ -0,0 +1,83 @@
+#ifndef socket_tiles_hpp
+#define socket_tiles_hpp
+
+#include "tiles.h"
+#include <vector>
+#include <poll.h>
+#include <sys/types.h>
+
+/// @brief connections of a forked tile worker, unix sockets to the coordinator and to the other workers
+///
+/// reads from the coordinator block while boids sent to other workers are queued
+/// and only written once the worker would block waiting for a boid or in flush
+class SocketTileLink : public TileLink
+{
+public:
+    /// @brief SocketTileLink constructor
+    /// @param tile index of the tile served by this worker
+    /// @param coordinator socket connected to the coordinator
+    /// @param peers sockets connected to the other workers, indexed by tile, -1 for this tile
+    SocketTileLink(unsigned int tile, int coordinator, std::vector<int> peers);
+
+    /// @brief closes the sockets
+    ~SocketTileLink() override;
+
+    SocketTileLink(const SocketTileLink &) = delete;
+    SocketTileLink &operator=(const SocketTileLink &) = delete;
+
+    unsigned int tile() const override;
+    bool read(void *data, std::size_t size) override;
+    void write(const void *data, std::size_t size) override;
+    void post(unsigned int peer, const tile_boid &boid) override;
+    void next(unsigned int peer, tile_boid &boid) override;
+    void flush() override;
+
+private:
+    /// @brief write as much of the queue of a worker as its socket accepts without blocking
+    /// @param peer tile of the worker
+    void send_queued(unsigned int peer);
+
+    /// @brief write as much of every queue as the sockets accept without blocking
+    void send_all_queued();
+
+    /// @brief wait until a socket is ready and move data between the sockets and the queues
+    void pump();
+
+private:
+    unsigned int tile_;
+    int coordinator_;
+    std::vector<int> peers_;
+    std::vector<std::vector<char>> outgoing_;   // queued bytes for each worker
+    std::vector<std::size_t> sent_;             // bytes of each queue already written
+    std::vector<std::vector<char>> incoming_;   // received bytes from each worker
+    std::vector<std::size_t> taken_;            // bytes of each received buffer already returned by next
+    std::vector<pollfd> fds_;                   // sockets polled by pump, kept to reuse the storage
+    std::vector<unsigned int> fd_tiles_;        // tile of each polled socket
+};
+
+/// @brief tile workers run as forked processes connected by unix sockets
+class SocketTileWorkers : public TileWorkers
+{
+public:
+    /// @brief SocketTileWorkers constructor, forks the workers
+    /// must be called before any thread is started as only the calling thread is copied into the workers
+    /// @param tiles number of workers
+    /// @param serve function run by each worker
+    SocketTileWorkers(unsigned int tiles, const serve_fn &serve);
+
+    /// @brief closes the connections and waits for the workers to exit
+    ~SocketTileWorkers() override;
+
+    SocketTileWorkers(const SocketTileWorkers &) = delete;
+    SocketTileWorkers &operator=(const SocketTileWorkers &) = delete;
+
+    unsigned int size() const override;
+    void write(unsigned int tile, const void *data, std::size_t size) override;
+    void read(unsigned int tile, void *data, std::size_t size) override;
+
+private:
+    std::vector<int> sockets_;
+    std::vector<pid_t> pids_;
+};
+
+#endif
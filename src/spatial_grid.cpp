@@ -0,0 +1,81 @@
+#include "spatial_grid.h"
+#include <algorithm>
+#include <cmath>
+
+// upper bound on tiles along an axis so tiny sight distances do not create huge grids
+constexpr int MAX_TILES_PER_AXIS = 256;
+
+SpatialGrid::SpatialGrid(float width, float height, float tile_size)
+{
+    tile_size_ = std::max({tile_size, width / MAX_TILES_PER_AXIS, height / MAX_TILES_PER_AXIS, 1.f});
+    cols_ = std::max(1, static_cast<int>(std::ceil(width / tile_size_)));
+    rows_ = std::max(1, static_cast<int>(std::ceil(height / tile_size_)));
+    tiles_.resize(cols_ * rows_);
+}
+
+void SpatialGrid::clear()
+{
+    // keep the capacity of each tile to avoid reallocating every update
+    for (auto &tile : tiles_)
+        tile.clear();
+}
+
+void SpatialGrid::insert(unsigned int i, const vec2 &pos)
+{
+    tiles_[tile_of(pos)].push_back(i);
+}
+
+void SpatialGrid::move(unsigned int i, const vec2 &old_pos, const vec2 &new_pos)
+{
+    auto from = tile_of(old_pos);
+    auto to = tile_of(new_pos);
+    if (from == to)
+        return;
+
+    auto &tile = tiles_[from];
+    auto it = std::find(tile.begin(), tile.end(), i);
+    if (it != tile.end())
+    {
+        *it = tile.back();
+        tile.pop_back();
+    }
+    tiles_[to].push_back(i);
+}
+
+void SpatialGrid::query(const vec2 &pos, std::vector<unsigned int> &out) const
+{
+    out.clear();
+
+    int cx = tile_coord(pos[0], cols_);
+    int cy = tile_coord(pos[1], rows_);
+
+    for (int y = std::max(cy - 1, 0); y <= std::min(cy + 1, rows_ - 1); ++y)
+    {
+        for (int x = std::max(cx - 1, 0); x <= std::min(cx + 1, cols_ - 1); ++x)
+        {
+            const auto &tile = tiles_[y * cols_ + x];
+            out.insert(out.end(), tile.begin(), tile.end());
+        }
+    }
+
+    // visit neighbors in the same order as a full scan of the flock
+    // so the floating point sums are identical to the brute force result
+    std::sort(out.begin(), out.end());
+}
+
+unsigned int SpatialGrid::tile_of(const vec2 &pos) const
+{
+    return tile_coord(pos[1], rows_) * cols_ + tile_coord(pos[0], cols_);
+}
+
+int SpatialGrid::tile_coord(float v, int tiles) const
+{
+    // boids outside the screen are clamped into the edge tiles
+    // clamping never separates two boids by more than one tile so queries stay exact
+    float t = std::floor(v / tile_size_);
+    if (!(t >= 0.f))
+        return 0;
+    if (t >= tiles - 1)
+        return tiles - 1;
+    return static_cast<int>(t);
+}
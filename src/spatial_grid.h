@@ -0,0 +1,109 @@
+#ifndef spatial_grid_hpp
+#define spatial_grid_hpp
+
+#include "gl_math.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <vector>
+
+/// @brief uniform grid of square tiles covering the screen used to find nearby boids
+class SpatialGrid
+{
+public:
+    /// @brief SpatialGrid constructor
+    /// @param width width of the area covered by the grid (pixels)
+    /// @param height height of the area covered by the grid (pixels)
+    /// @param tile_size minimum side length of a tile (pixels)
+    SpatialGrid(float width, float height, float tile_size);
+
+    /// @brief remove every boid from the grid
+    void clear();
+
+    /// @brief add a boid to the tile containing its position
+    /// @param i index of the boid
+    /// @param pos position of the boid
+    void insert(unsigned int i, const vec2 &pos);
+
+    /// @brief move a boid to the tile containing its new position
+    /// @param i index of the boid
+    /// @param old_pos position the boid was inserted with
+    /// @param new_pos new position of the boid
+    void move(unsigned int i, const vec2 &old_pos, const vec2 &new_pos);
+
+    /// @brief collect every boid in the tile containing a position and its 8 neighboring tiles
+    /// boids outside the grid are kept in the nearest edge tile so none are ever missed
+    /// @param pos position to search around
+    /// @param out filled with the indices of the found boids in ascending order
+    void query(const vec2 &pos, std::vector<unsigned int> &out) const;
+
+    /// @brief find the boid closest to a position
+    /// searches rings of tiles outwards and stops once no closer boid can be found
+    /// @param pos position to search around
+    /// @param position callable returning the position of a boid from its index
+    /// @param found set to the index of the closest boid, the lowest index if several are equally close
+    /// @return true if the grid holds any boid
+    template <typename PositionFn>
+    bool nearest(const vec2 &pos, PositionFn position, unsigned int &found) const;
+
+private:
+    /// @brief find the tile holding a position
+    /// @param pos position to look up
+    /// @return index of the tile
+    unsigned int tile_of(const vec2 &pos) const;
+
+    /// @brief clamp a coordinate to a tile column or row
+    /// @param v coordinate (pixels)
+    /// @param tiles number of tiles along the axis
+    /// @return the column or row
+    int tile_coord(float v, int tiles) const;
+
+private:
+    float tile_size_;
+    int cols_, rows_;
+    std::vector<std::vector<unsigned int>> tiles_;
+};
+
+template <typename PositionFn>
+bool SpatialGrid::nearest(const vec2 &pos, PositionFn position, unsigned int &found) const
+{
+    int cx = tile_coord(pos[0], cols_);
+    int cy = tile_coord(pos[1], rows_);
+    float best = INFINITY;
+    found = std::numeric_limits<unsigned int>::max();
+
+    for (int ring = 0; ring < std::max(cols_, rows_); ++ring)
+    {
+        // every boid in this ring is at least ring - 1 tiles away
+        float closest_possible = std::max(ring - 1, 0) * tile_size_;
+        if (closest_possible * closest_possible > best)
+            break;
+
+        for (int y = std::max(cy - ring, 0); y <= std::min(cy + ring, rows_ - 1); ++y)
+        {
+            // only the tiles on the border of the ring, the inside was already searched
+            bool edge_row = y == cy - ring || y == cy + ring;
+            int step = edge_row ? 1 : 2 * ring;
+            for (int x = cx - ring; x <= cx + ring; x += std::max(step, 1))
+            {
+                if (x < 0 || x >= cols_)
+                    continue;
+
+                for (auto i : tiles_[y * cols_ + x])
+                {
+                    // ties go to the lowest index so the order boids were inserted or moved in never matters
+                    auto dist = (position(i) - pos).squared_mag();
+                    if (dist < best || (dist == best && i < found))
+                    {
+                        best = dist;
+                        found = i;
+                    }
+                }
+            }
+        }
+    }
+
+    return best != INFINITY;
+}
+
+#endif
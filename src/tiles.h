@@ -0,0 +1,82 @@
+#ifndef tiles_hpp
+#define tiles_hpp
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+
+// most tiles supported, the halo tiles of a boid are sent as a 32 bit mask
+constexpr unsigned int MAX_TILES = 32;
+
+/// @brief state of a boid sent between the coordinator and the tile workers
+struct tile_boid
+{
+    std::uint32_t index;   // index of the boid in the flock
+    std::uint32_t tiles;   // owned boids: mask of the tiles holding it in their halo, halo boids: owning tile
+    float pos[2];          // position (pixels)
+    float vel[2];          // velocity (pixels/sec)
+};
+
+/// @brief transport seen by a tile worker, its connection to the coordinator and to the other workers
+class TileLink
+{
+public:
+    virtual ~TileLink() = default;
+
+    /// @brief get the tile served by this worker
+    /// @return index of the tile
+    virtual unsigned int tile() const = 0;
+
+    /// @brief read from the coordinator, blocks until all the data has arrived
+    /// @param data filled with the data
+    /// @param size number of bytes to read
+    /// @return false if the coordinator closed the connection before any data arrived
+    virtual bool read(void *data, std::size_t size) = 0;
+
+    /// @brief write to the coordinator, blocks until all the data is sent
+    /// @param data data to write
+    /// @param size number of bytes to write
+    virtual void write(const void *data, std::size_t size) = 0;
+
+    /// @brief queue a boid to be sent to another worker
+    /// @param peer tile of the worker
+    /// @param boid the boid
+    virtual void post(unsigned int peer, const tile_boid &boid) = 0;
+
+    /// @brief get the next boid sent by another worker, in the order they were posted
+    /// must send the queued boids while waiting so two workers waiting on each other always progress
+    /// @param peer tile of the worker
+    /// @param boid set to the boid
+    virtual void next(unsigned int peer, tile_boid &boid) = 0;
+
+    /// @brief send every queued boid, blocks until they are all written
+    virtual void flush() = 0;
+};
+
+/// @brief transport seen by the coordinator, the workers which each update the boids in one tile of the world
+class TileWorkers
+{
+public:
+    /// @brief function run by each worker until the coordinator closes its connection
+    using serve_fn = std::function<void(TileLink &)>;
+
+    virtual ~TileWorkers() = default;
+
+    /// @brief get the number of workers
+    /// @return number of workers
+    virtual unsigned int size() const = 0;
+
+    /// @brief write to a worker, blocks until all the data is sent
+    /// @param tile tile of the worker
+    /// @param data data to write
+    /// @param size number of bytes to write
+    virtual void write(unsigned int tile, const void *data, std::size_t size) = 0;
+
+    /// @brief read from a worker, blocks until all the data has arrived
+    /// @param tile tile of the worker
+    /// @param data filled with the data
+    /// @param size number of bytes to read
+    virtual void read(unsigned int tile, void *data, std::size_t size) = 0;
+};
+
+#endif
@@ -28,7 +28,7 @@ float FrameLimiter::frame_dt() const
 
 namespace po = boost::program_options;
 
-Flock::parameters handle_arguments(int argc, char *argv[])
+Flock::parameters handle_arguments(int argc, char *argv[], FrameRecorder::options &record, std::string &control_path)
 {
     auto range = [](float min, float max, char const *const opt_name)
     {
@@ -47,7 +47,7 @@ Flock::parameters handle_arguments(int argc, char *argv[])
     po::options_description desc("Allowed options");
     try
     {
-        desc.add_options()("help,h", "help screen")("cohesion", po::value<float>(&params.cohesion_factor)->default_value(0.5f)->notifier(range(0.f, 1.f, "cohesion")), "set cohesion factor | range [0.0, 1.0]")("alignment", po::value<float>(&params.alignment_factor)->default_value(0.5f)->notifier(range(0.f, 1.f, "alignment")), "set alignment factor | range [0.0, 1.0]")("separation", po::value<float>(&params.separation_factor)->default_value(0.5f)->notifier(range(0.f, 1.f, "separation")), "set separation factor | range [0.0, 1.0]")("n", po::value<int>(&params.n)->default_value(50)->notifier(range(1, INFINITY, "n")), "number of boids")("seed", po::value<unsigned int>(), "seed for random number generator used")("sight-distance", po::value<float>(&params.sight_dist)->default_value(50)->notifier(range(0.f, INFINITY, "sight-distance")), "boid sight distance (pixels) | range [0.0, inf)")("sight-angle", po::value<float>(&params.sight_angle)->default_value(90.f)->notifier(range(0.f, 360.f, "sight-angle")), "boid field of view (degrees) | range [0.0, 360.0]")("separation-distance", po::value<float>(&params.separation_dist)->default_value(25.f)->notifier(range(0.f, INFINITY, "separation-distance")), "boid separation distance | range [0.0, inf)")("wrap", po::bool_switch(&params.wrap)->default_value(false), "wrap boids if outside screen");
+        desc.add_options()("help,h", "help screen")("cohesion", po::value<float>(&params.cohesion_factor)->default_value(0.5f)->notifier(range(0.f, 1.f, "cohesion")), "set cohesion factor | range [0.0, 1.0]")("alignment", po::value<float>(&params.alignment_factor)->default_value(0.5f)->notifier(range(0.f, 1.f, "alignment")), "set alignment factor | range [0.0, 1.0]")("separation", po::value<float>(&params.separation_factor)->default_value(0.5f)->notifier(range(0.f, 1.f, "separation")), "set separation factor | range [0.0, 1.0]")("n", po::value<int>(&params.n)->default_value(50)->notifier(range(1, MAX_BOIDS, "n")), "number of boids | range [1, 16777216]")("seed", po::value<unsigned int>(), "seed for random number generator used")("sight-distance", po::value<float>(&params.sight_dist)->default_value(50)->notifier(range(0.f, INFINITY, "sight-distance")), "boid sight distance (pixels) | range [0.0, inf)")("sight-angle", po::value<float>(&params.sight_angle)->default_value(90.f)->notifier(range(0.f, 360.f, "sight-angle")), "boid field of view (degrees) | range [0.0, 360.0]")("separation-distance", po::value<float>(&params.separation_dist)->default_value(25.f)->notifier(range(0.f, INFINITY, "separation-distance")), "boid separation distance | range [0.0, inf)")("wander", po::value<float>(&params.wander_factor)->default_value(0.f)->notifier(range(0.f, 1.f, "wander")), "set random wander factor | range [0.0, 1.0]")("predators", po::value<int>(&params.predators)->default_value(0)->notifier(range(0, INFINITY, "predators")), "number of predators chasing the boids")("flee-distance", po::value<float>(&params.flee_dist)->default_value(100.f)->notifier(range(0.f, INFINITY, "flee-distance")), "distance at which boids flee from predators | range [0.0, inf)")("wrap", po::bool_switch(&params.wrap)->default_value(false), "wrap boids if outside screen")("compact", po::bool_switch(&params.compact)->default_value(false), "store boids with 16 bit positions and half float velocities | only reduces memory use, updates are slower")("processes", po::value<int>(&params.processes)->default_value(1)->notifier(range(1, MAX_TILES, "processes")), "worker processes updating vertical strips of the world in parallel | range [1, 32]")("output", po::value<std::string>(&record.output), "render offscreen and record to this path instead of opening a window | ppm: prefix of the image sequence, y4m: file or - for stdout")("format", po::value<std::string>(&record.format)->default_value("ppm"), "recording format | ppm or y4m")("frames", po::value<unsigned int>(&record.frames)->default_value(600), "number of frames to record")("control", po::value<std::string>(&control_path), "path of a unix socket to change parameters and query stats while running");
 
         po::variables_map vm;
         po::store(po::parse_command_line(argc, argv, desc), vm);
@@ -58,6 +58,10 @@ Flock::parameters handle_arguments(int argc, char *argv[])
             std::cout << desc << '\n';
             exit(0);
         }
+        if (params.compact && params.processes > 1)
+        {
+            throw po::error("the option '--compact' can not be combined with '--processes'");
+        }
         if (vm.count("seed"))
         {
             params.seed = vm["seed"].as<unsigned int>();
@@ -2,6 +2,7 @@
 #define utils_h
 
 #include "flock.h"
+#include "recorder.h"
 #include <chrono>
 
 /// @brief class to limit frames
@@ -28,7 +29,9 @@ private:
 /// @brief handle command line arguments
 /// @param argc
 /// @param argv
+/// @param record set with the options for an offscreen recording
+/// @param control_path set with the path of the control socket, empty if not requested
 /// @return a parameters struct set with the parameters for the simulation
-Flock::parameters handle_arguments(int argc, char *argv[]);
+Flock::parameters handle_arguments(int argc, char *argv[], FrameRecorder::options &record, std::string &control_path);
 
 #endif
\ No newline at end of file